@@ -0,0 +1,142 @@
+/* Copyright (c) 2010, Ben Noordhuis <info@bnoordhuis.nl>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef AHO_CORASICK_H
+#define AHO_CORASICK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Aho-Corasick automaton for finding many needles in one pass.
+//
+// The trie is compiled into a full DFA so the scan loop does exactly one
+// table lookup per input byte. Bytes that don't occur in any needle share
+// a single character class, which keeps the transition table small.
+class AhoCorasick {
+ public:
+  AhoCorasick(): classes_(1) {
+    memset(byte_class_, 0, sizeof(byte_class_));
+  }
+
+  // Needles must be added before build(). Empty needles never match.
+  void add(const uint8_t* needle, size_t size) {
+    needles_.push_back(std::string((const char*) needle, size));
+  }
+
+  void build() {
+    for (size_t i = 0; i < needles_.size(); ++i) {
+      const std::string& needle = needles_[i];
+      for (size_t k = 0; k < needle.size(); ++k) {
+        const uint8_t c = needle[k];
+        if (byte_class_[c] == 0) byte_class_[c] = classes_++;
+      }
+    }
+
+    new_state();
+    chain_.assign(needles_.size(), -1);
+    for (size_t i = 0; i < needles_.size(); ++i) {
+      const std::string& needle = needles_[i];
+      if (needle.empty()) continue;
+
+      int32_t state = 0;
+      for (size_t k = 0; k < needle.size(); ++k) {
+        const uint8_t c = needle[k];
+        const size_t slot = state * classes_ + byte_class_[c];
+        if (next_[slot] == 0) {
+          const int32_t child = new_state();
+          next_[slot] = child;
+        }
+        state = next_[slot];
+      }
+      chain_[i] = output_[state];  // identical needles
+      output_[state] = i;
+    }
+
+    // Breadth-first over the trie, turning missing transitions into
+    // failure transitions. The root's children fail back to the root and
+    // 0 doubles as "no transition" in the trie because nothing points back
+    // to the root.
+    std::vector<int32_t> fail(output_.size(), 0);
+    std::vector<int32_t> queue;
+    queue.push_back(0);
+    for (size_t head = 0; head < queue.size(); ++head) {
+      const int32_t state = queue[head];
+      for (size_t c = 0; c < classes_; ++c) {
+        const size_t slot = state * classes_ + c;
+        const int32_t child = next_[slot];
+        const int32_t fallback =
+            state == 0 ? 0 : next_[fail[state] * classes_ + c];
+        if (child == 0) {
+          next_[slot] = fallback;
+          continue;
+        }
+        fail[child] = fallback;
+        emit_[child] = output_[child] >= 0 ? child : emit_[fallback];
+        queue.push_back(child);
+      }
+    }
+
+    // Link every state with output to the next one on its failure path.
+    dict_.assign(output_.size(), -1);
+    for (size_t state = 1; state < output_.size(); ++state) {
+      if (output_[state] >= 0) dict_[state] = emit_[fail[state]];
+    }
+  }
+
+  // Calls report(offset, id) for every match in data, in the order in
+  // which the matches end. Returns the number of matches.
+  template <typename Callback>
+  size_t scan(const uint8_t* data, size_t size, Callback& report) const {
+    const int32_t* next = &next_[0];
+    const int32_t* emit = &emit_[0];
+    const size_t classes = classes_;
+    size_t count = 0;
+
+    int32_t state = 0;
+    for (size_t i = 0; i < size; ++i) {
+      state = next[state * classes + byte_class_[data[i]]];
+      for (int32_t s = emit[state]; s >= 0; s = dict_[s]) {
+        for (int32_t id = output_[s]; id >= 0; id = chain_[id]) {
+          report(i + 1 - needles_[id].size(), id);
+          ++count;
+        }
+      }
+    }
+
+    return count;
+  }
+
+ private:
+  int32_t new_state() {
+    next_.resize(next_.size() + classes_, 0);
+    output_.push_back(-1);
+    emit_.push_back(-1);
+    return output_.size() - 1;
+  }
+
+  uint16_t byte_class_[256];
+  size_t classes_;
+  std::vector<std::string> needles_;
+  std::vector<int32_t> next_;    // transitions, states x classes
+  std::vector<int32_t> output_;  // needle that ends in state or -1
+  std::vector<int32_t> emit_;    // first state with output on fail path
+  std::vector<int32_t> dict_;    // next state with output on fail path
+  std::vector<int32_t> chain_;   // next needle with identical bytes
+};
+
+#endif  // AHO_CORASICK_H
@@ -0,0 +1,145 @@
+/* Copyright (c) 2010, Ben Noordhuis <info@bnoordhuis.nl>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BASE32_H
+#define BASE32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Base32 encoding and decoding (RFC 4648), the A-Z2-7 alphabet. The
+// decoder accepts lower case too.
+//
+// Works like Base64.h: base32_encode() writes base32_encoded_size()
+// characters, base32_decode() decodes |size| characters without the
+// padding into base32_decoded_size() bytes and returns false on a
+// character that's not in the alphabet. Every 5 bytes are handled as one
+// 40 bits word, so there's a single table lookup per character and no
+// branches in the loop.
+
+static const char base32_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+
+struct base32_tables {
+  signed char values[256];
+};
+
+static inline const base32_tables* base32_tables_create() {
+  static base32_tables tables;
+  for (int i = 0; i < 256; ++i) {
+    tables.values[i] = -1;
+  }
+  for (int i = 0; i < 32; ++i) {
+    const uint8_t c = (uint8_t) base32_alphabet[i];
+    tables.values[c] = (signed char) i;
+    if (c >= 'A' && c <= 'Z') {
+      tables.values[c + 'a' - 'A'] = (signed char) i;
+    }
+  }
+  return &tables;
+}
+
+static inline size_t base32_encoded_size(size_t size, bool padding) {
+  return padding ? (size + 4) / 5 * 8 : (size * 8 + 4) / 5;
+}
+
+static inline size_t base32_decoded_size(size_t size) {
+  return size * 5 / 8;
+}
+
+// Strips the padding, see base64_unpad(). 2, 4, 5 or 7 characters are left
+// over for 1, 2, 3 or 4 trailing bytes.
+static inline bool base32_unpad(const uint8_t* src, size_t* size) {
+  size_t n = *size;
+  size_t pad = 0;
+  while (pad < 6 && n > 0 && src[n - 1] == '=') {
+    --n;
+    ++pad;
+  }
+  if (pad > 0 && (*size % 8 != 0 || n % 8 + pad != 8)) {
+    return false;
+  }
+  *size = n;
+  const size_t rest = n % 8;
+  return rest != 1 && rest != 3 && rest != 6;
+}
+
+static inline void base32_encode(char* dst,
+                                 const uint8_t* src,
+                                 size_t size,
+                                 bool padding) {
+  size_t i = 0;
+  for (; i + 5 <= size; i += 5) {
+    uint64_t x = 0;
+    for (int k = 0; k < 5; ++k) {
+      x = (x << 8) | src[i + k];
+    }
+    for (int k = 0; k < 8; ++k) {
+      *dst++ = base32_alphabet[(x >> (35 - 5 * k)) & 31];
+    }
+  }
+  if (i < size) {
+    uint64_t x = 0;
+    for (size_t k = 0; k < 5; ++k) {
+      x = (x << 8) | (i + k < size ? src[i + k] : 0);
+    }
+    const size_t chars = ((size - i) * 8 + 4) / 5;
+    for (size_t k = 0; k < 8; ++k) {
+      if (k < chars) {
+        *dst++ = base32_alphabet[(x >> (35 - 5 * k)) & 31];
+      } else if (padding) {
+        *dst++ = '=';
+      }
+    }
+  }
+}
+
+static inline bool base32_decode(uint8_t* dst,
+                                 const uint8_t* src,
+                                 size_t size) {
+  static const base32_tables* const tables = base32_tables_create();
+  const signed char* values = tables->values;
+
+  int invalid = 0;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t x = 0;
+    for (int k = 0; k < 8; ++k) {
+      const int v = values[src[i + k]];
+      invalid |= v;
+      x = (x << 5) | (v & 31);
+    }
+    for (int k = 0; k < 5; ++k) {
+      *dst++ = (uint8_t) (x >> (32 - 8 * k));
+    }
+  }
+  if (i < size) {
+    uint64_t x = 0;
+    for (size_t k = 0; k < 8; ++k) {
+      int v = 0;
+      if (i + k < size) {
+        v = values[src[i + k]];
+        invalid |= v;
+      }
+      x = (x << 5) | (v & 31);
+    }
+    const size_t bytes = (size - i) * 5 / 8;
+    for (size_t k = 0; k < bytes; ++k) {
+      *dst++ = (uint8_t) (x >> (32 - 8 * k));
+    }
+  }
+  return invalid >= 0;
+}
+
+#endif  // BASE32_H
@@ -0,0 +1,403 @@
+/* Copyright (c) 2010, Ben Noordhuis <info@bnoordhuis.nl>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BASE64_H
+#define BASE64_H
+
+#include "CpuFeatures.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Base64 encoding and decoding (RFC 4648), with the standard or the URL and
+// filename safe alphabet.
+//
+// base64_encode() writes base64_encoded_size() characters to |dst|, with or
+// without '=' padding.
+//
+// base64_decode() decodes |size| characters without the padding, see
+// base64_unpad(), into base64_decoded_size() bytes. Returns false if the
+// input contains a character that is not in the alphabet, in which case
+// the contents of |dst| are unspecified.
+//
+// The AVX2 and SSSE3 kernels translate 32 or 16 characters at a time with
+// pshufb lookups (Muła's method): the encoder maps 6 bits indexes to
+// characters by adding an offset that depends on the range the index is
+// in, the decoder validates every character with two tables indexed by its
+// high and low nibble and adds the offset that its high nibble selects.
+// The encoder reads 4 bytes and the decoder writes 4 or 8 bytes past the
+// block that they are working on, so they stop short of the end and the
+// scalar code does the rest.
+
+static const char base64_alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char base64url_alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// Character values for both alphabets, -1 for invalid characters.
+struct base64_tables {
+  signed char values[2][256];
+};
+
+static inline const base64_tables* base64_tables_create() {
+  static base64_tables tables;
+  for (int i = 0; i < 256; ++i) {
+    tables.values[0][i] = tables.values[1][i] = -1;
+  }
+  for (int i = 0; i < 64; ++i) {
+    tables.values[0][(uint8_t) base64_alphabet[i]] = (signed char) i;
+    tables.values[1][(uint8_t) base64url_alphabet[i]] = (signed char) i;
+  }
+  return &tables;
+}
+
+static inline size_t base64_encoded_size(size_t size, bool padding) {
+  return padding ? (size + 2) / 3 * 4 : (size * 4 + 2) / 3;
+}
+
+// The number of bytes that |size| characters without padding decode to.
+static inline size_t base64_decoded_size(size_t size) {
+  return size / 4 * 3 + (size % 4 == 0 ? 0 : size % 4 - 1);
+}
+
+// Strips the padding from |size| characters of base64. Returns false if the
+// padding is wrong or if there is a dangling character that can't be
+// decoded. Unpadded input is accepted too.
+static inline bool base64_unpad(const uint8_t* src, size_t* size) {
+  size_t n = *size;
+  size_t pad = 0;
+  while (pad < 2 && n > 0 && src[n - 1] == '=') {
+    --n;
+    ++pad;
+  }
+  if (pad > 0 && (*size % 4 != 0 || n % 4 + pad != 4)) {
+    return false;
+  }
+  *size = n;
+  return n % 4 != 1;
+}
+
+// Portable fallbacks, also used for the tails that the SIMD loops leave.
+static inline void base64_encode_scalar(char* dst,
+                                        const uint8_t* src,
+                                        size_t size,
+                                        bool url,
+                                        bool padding) {
+  const char* alphabet = url ? base64url_alphabet : base64_alphabet;
+  size_t i = 0;
+  for (; i + 3 <= size; i += 3) {
+    const uint32_t x = (src[i] << 16) | (src[i + 1] << 8) | src[i + 2];
+    *dst++ = alphabet[x >> 18];
+    *dst++ = alphabet[(x >> 12) & 63];
+    *dst++ = alphabet[(x >> 6) & 63];
+    *dst++ = alphabet[x & 63];
+  }
+  if (i < size) {
+    const uint32_t x = (src[i] << 16) | (i + 1 < size ? src[i + 1] << 8 : 0);
+    *dst++ = alphabet[x >> 18];
+    *dst++ = alphabet[(x >> 12) & 63];
+    if (i + 1 < size) {
+      *dst++ = alphabet[(x >> 6) & 63];
+    } else if (padding) {
+      *dst++ = '=';
+    }
+    if (padding) {
+      *dst++ = '=';
+    }
+  }
+}
+
+static inline bool base64_decode_scalar(uint8_t* dst,
+                                        const uint8_t* src,
+                                        size_t size,
+                                        bool url) {
+  static const base64_tables* const tables = base64_tables_create();
+  const signed char* values = tables->values[url];
+
+  int invalid = 0;
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    const int a = values[src[i]];
+    const int b = values[src[i + 1]];
+    const int c = values[src[i + 2]];
+    const int d = values[src[i + 3]];
+    // Invalid characters are -1, the sign of |invalid| keeps track of them.
+    // The shifts are unsigned, shifting a negative int is undefined.
+    invalid |= a | b | c | d;
+    const uint32_t x = ((uint32_t) a << 18) | ((uint32_t) b << 12) |
+                       ((uint32_t) c << 6) | (uint32_t) d;
+    *dst++ = (uint8_t) (x >> 16);
+    *dst++ = (uint8_t) (x >> 8);
+    *dst++ = (uint8_t) x;
+  }
+  if (i < size) {
+    // Two or three characters, base64_unpad() has rejected one.
+    const int a = values[src[i]];
+    const int b = values[src[i + 1]];
+    const int c = i + 2 < size ? values[src[i + 2]] : 0;
+    invalid |= a | b | c;
+    const uint32_t x = ((uint32_t) a << 18) | ((uint32_t) b << 12) |
+                       ((uint32_t) c << 6);
+    *dst++ = (uint8_t) (x >> 16);
+    if (i + 2 < size) {
+      *dst++ = (uint8_t) (x >> 8);
+    }
+  }
+  return invalid >= 0;
+}
+
+#if defined(BUFFERTOOLS_X86)
+// The lookup tables of the kernels, one 16 byte lane's worth.
+BUFFERTOOLS_TARGET("ssse3")
+static inline __m128i base64_encode_offsets(bool url) {
+  // Offsets from the index to the character: 0-25 map to entry 13, 26-51
+  // to entry 0, 52-61 to 1-10, 62 and 63 to 11 and 12.
+  return _mm_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      (url ? '-' : '+') - 62, (url ? '_' : '/') - 63, 'A', 0, 0);
+}
+
+// A character is valid if the entries for its low and high nibble have no
+// bits in common. The offset is selected by the high nibble, '/' and '_'
+// share theirs with other characters so they are moved to entry 10 or 13.
+BUFFERTOOLS_TARGET("ssse3")
+static inline __m128i base64_decode_lo_lut(bool url) {
+  return url ?
+      _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                    0x11, 0x11, 0x13, 0x3b, 0x3b, 0x3a, 0x3b, 0x33) :
+      _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                    0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+}
+
+BUFFERTOOLS_TARGET("ssse3")
+static inline __m128i base64_decode_hi_lut(bool url) {
+  return url ?
+      _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x20,
+                    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10) :
+      _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+}
+
+BUFFERTOOLS_TARGET("ssse3")
+static inline __m128i base64_decode_offset_lut(bool url) {
+  return url ?
+      _mm_setr_epi8(0, 0, 62 - '-', 52 - '0', -'A', -'A', 26 - 'a', 26 - 'a',
+                    0, 0, 0, 0, 0, 63 - '_', 0, 0) :
+      _mm_setr_epi8(0, 0, 62 - '+', 52 - '0', -'A', -'A', 26 - 'a', 26 - 'a',
+                    0, 0, 63 - '/', 0, 0, 0, 0, 0);
+}
+
+// Splits every 3 bytes in the low 12 bytes into four 6 bits indexes, one
+// per byte.
+BUFFERTOOLS_TARGET("ssse3")
+static inline __m128i base64_unpack_ssse3(__m128i v) {
+  v = _mm_shuffle_epi8(v, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4,
+                                        7, 6, 8, 7, 10, 9, 11, 10));
+  const __m128i a = _mm_mulhi_epu16(
+      _mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)),
+      _mm_set1_epi32(0x04000040));
+  const __m128i b = _mm_mullo_epi16(
+      _mm_and_si128(v, _mm_set1_epi32(0x003f03f0)),
+      _mm_set1_epi32(0x01000010));
+  return _mm_or_si128(a, b);
+}
+
+BUFFERTOOLS_TARGET("ssse3")
+static size_t base64_encode_ssse3(char* dst,
+                                  const uint8_t* src,
+                                  size_t size,
+                                  bool url) {
+  const __m128i offset_lut = base64_encode_offsets(url);
+
+  size_t i = 0;
+  for (; i + 16 <= size; i += 12) {
+    const __m128i indexes =
+        base64_unpack_ssse3(_mm_loadu_si128((const __m128i*) (src + i)));
+    __m128i entry = _mm_subs_epu8(indexes, _mm_set1_epi8(51));
+    const __m128i letters = _mm_cmpgt_epi8(_mm_set1_epi8(26), indexes);
+    entry = _mm_or_si128(entry, _mm_and_si128(letters, _mm_set1_epi8(13)));
+    const __m128i chars =
+        _mm_add_epi8(indexes, _mm_shuffle_epi8(offset_lut, entry));
+    _mm_storeu_si128((__m128i*) (dst + i / 3 * 4), chars);
+  }
+  return i;
+}
+
+BUFFERTOOLS_TARGET("ssse3")
+static size_t base64_decode_ssse3(uint8_t* dst,
+                                  const uint8_t* src,
+                                  size_t size,
+                                  bool url,
+                                  bool* valid) {
+  const __m128i lo_lut = base64_decode_lo_lut(url);
+  const __m128i hi_lut = base64_decode_hi_lut(url);
+  const __m128i offset_lut = base64_decode_offset_lut(url);
+  const __m128i special = _mm_set1_epi8(url ? '_' : '/');
+  const __m128i nibble = _mm_set1_epi8(15);
+
+  __m128i invalid = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 24 <= size; i += 16) {
+    const __m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+    const __m128i hi = _mm_and_si128(_mm_srli_epi32(v, 4), nibble);
+    const __m128i lo = _mm_and_si128(v, nibble);
+    invalid = _mm_or_si128(invalid, _mm_and_si128(
+        _mm_shuffle_epi8(lo_lut, lo), _mm_shuffle_epi8(hi_lut, hi)));
+    const __m128i entry = _mm_xor_si128(
+        hi,
+        _mm_and_si128(_mm_cmpeq_epi8(v, special), _mm_set1_epi8(8)));
+    const __m128i values =
+        _mm_add_epi8(v, _mm_shuffle_epi8(offset_lut, entry));
+    const __m128i pairs =
+        _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    __m128i out = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+    out = _mm_shuffle_epi8(out, _mm_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    _mm_storeu_si128((__m128i*) (dst + i / 4 * 3), out);
+  }
+  *valid = _mm_movemask_epi8(_mm_cmpeq_epi8(invalid, _mm_setzero_si128())) ==
+           0xffff;
+  return i;
+}
+
+// Splits every 3 bytes in the low 12 bytes of each lane into four 6 bits
+// indexes, one per byte.
+BUFFERTOOLS_TARGET("avx2")
+static inline __m256i base64_unpack_avx2(__m256i v) {
+  v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4,
+                                              7, 6, 8, 7, 10, 9, 11, 10,
+                                              1, 0, 2, 1, 4, 3, 5, 4,
+                                              7, 6, 8, 7, 10, 9, 11, 10));
+  const __m256i a = _mm256_mulhi_epu16(
+      _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00)),
+      _mm256_set1_epi32(0x04000040));
+  const __m256i b = _mm256_mullo_epi16(
+      _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0)),
+      _mm256_set1_epi32(0x01000010));
+  return _mm256_or_si256(a, b);
+}
+
+BUFFERTOOLS_TARGET("avx2")
+static size_t base64_encode_avx2(char* dst,
+                                 const uint8_t* src,
+                                 size_t size,
+                                 bool url) {
+  const __m256i offset_lut =
+      _mm256_broadcastsi128_si256(base64_encode_offsets(url));
+
+  size_t i = 0;
+  for (; i + 28 <= size; i += 24) {
+    const __m256i v = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) (src + i))),
+        _mm_loadu_si128((const __m128i*) (src + i + 12)),
+        1);
+    const __m256i indexes = base64_unpack_avx2(v);
+    __m256i entry = _mm256_subs_epu8(indexes, _mm256_set1_epi8(51));
+    const __m256i letters = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indexes);
+    entry = _mm256_or_si256(entry,
+                            _mm256_and_si256(letters, _mm256_set1_epi8(13)));
+    const __m256i chars =
+        _mm256_add_epi8(indexes, _mm256_shuffle_epi8(offset_lut, entry));
+    _mm256_storeu_si256((__m256i*) (dst + i / 3 * 4), chars);
+  }
+  return i;
+}
+
+BUFFERTOOLS_TARGET("avx2")
+static size_t base64_decode_avx2(uint8_t* dst,
+                                 const uint8_t* src,
+                                 size_t size,
+                                 bool url,
+                                 bool* valid) {
+  const __m256i lo_lut = _mm256_broadcastsi128_si256(base64_decode_lo_lut(url));
+  const __m256i hi_lut = _mm256_broadcastsi128_si256(base64_decode_hi_lut(url));
+  const __m256i offset_lut =
+      _mm256_broadcastsi128_si256(base64_decode_offset_lut(url));
+  const __m256i special = _mm256_set1_epi8(url ? '_' : '/');
+  const __m256i nibble = _mm256_set1_epi8(15);
+
+  __m256i invalid = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 48 <= size; i += 32) {
+    const __m256i v = _mm256_loadu_si256((const __m256i*) (src + i));
+    const __m256i hi = _mm256_and_si256(_mm256_srli_epi32(v, 4), nibble);
+    const __m256i lo = _mm256_and_si256(v, nibble);
+    invalid = _mm256_or_si256(invalid, _mm256_and_si256(
+        _mm256_shuffle_epi8(lo_lut, lo), _mm256_shuffle_epi8(hi_lut, hi)));
+    // Bytes >= 0x80 have a high nibble of 8 or more, both tables reject
+    // them, whatever the offset table says.
+    const __m256i entry = _mm256_xor_si256(
+        hi,
+        _mm256_and_si256(_mm256_cmpeq_epi8(v, special),
+                         _mm256_set1_epi8(8)));
+    const __m256i values =
+        _mm256_add_epi8(v, _mm256_shuffle_epi8(offset_lut, entry));
+    // Join four 6 bits values into 3 bytes per 32 bits lane.
+    const __m256i pairs = _mm256_maddubs_epi16(
+        values, _mm256_set1_epi32(0x01400140));
+    __m256i out = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+    out = _mm256_shuffle_epi8(out, _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    out = _mm256_permutevar8x32_epi32(
+        out, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+    _mm256_storeu_si256((__m256i*) (dst + i / 4 * 3), out);
+  }
+  *valid = _mm256_testz_si256(invalid, invalid) != 0;
+  return i;
+}
+#endif  // BUFFERTOOLS_X86
+
+static inline void base64_encode(char* dst,
+                                 const uint8_t* src,
+                                 size_t size,
+                                 bool url,
+                                 bool padding) {
+  size_t i = 0;
+#if defined(BUFFERTOOLS_X86)
+  if (cpu_has(CPU_AVX2)) {
+    i = base64_encode_avx2(dst, src, size, url);
+  } else if (cpu_has(CPU_SSSE3)) {
+    i = base64_encode_ssse3(dst, src, size, url);
+  }
+#endif
+  base64_encode_scalar(dst + i / 3 * 4, src + i, size - i, url, padding);
+}
+
+static inline bool base64_decode(uint8_t* dst,
+                                 const uint8_t* src,
+                                 size_t size,
+                                 bool url) {
+  size_t i = 0;
+#if defined(BUFFERTOOLS_X86)
+  if (cpu_has(CPU_AVX2)) {
+    bool valid;
+    i = base64_decode_avx2(dst, src, size, url, &valid);
+    if (!valid) {
+      return false;
+    }
+  } else if (cpu_has(CPU_SSSE3)) {
+    bool valid;
+    i = base64_decode_ssse3(dst, src, size, url, &valid);
+    if (!valid) {
+      return false;
+    }
+  }
+#endif
+  return base64_decode_scalar(dst + i / 4 * 3, src + i, size - i, url);
+}
+
+#endif  // BASE64_H
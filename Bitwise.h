@@ -0,0 +1,203 @@
+/* Copyright (c) 2010, Ben Noordhuis <info@bnoordhuis.nl>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BITWISE_H
+#define BITWISE_H
+
+#include "CpuFeatures.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Bitwise AND, OR and XOR of a buffer with an operand that is repeated
+// when it's shorter than the buffer:
+//
+//   dst[i] = src[i] OP operand[i % operand_size]
+//
+// |dst| and |src| may be the same buffer. The kernels work on 8 bytes at
+// a time, or 16 or 32 bytes with SSE2 or AVX2. A short operand is first
+// unrolled into a block of whole repetitions so the kernels never have to
+// deal with the wrap-around.
+#define BITWISE_BLOCK_SIZE 256
+
+struct bitwise_and {
+  static inline uint8_t op(uint8_t a, uint8_t b) { return a & b; }
+  static inline uint64_t op(uint64_t a, uint64_t b) { return a & b; }
+#if defined(BUFFERTOOLS_SSE2)
+  static inline __m128i op(__m128i a, __m128i b) {
+    return _mm_and_si128(a, b);
+  }
+#endif
+#if defined(BUFFERTOOLS_X86)
+  BUFFERTOOLS_TARGET("avx2")
+  static inline __m256i op(__m256i a, __m256i b) {
+    return _mm256_and_si256(a, b);
+  }
+#endif
+};
+
+struct bitwise_or {
+  static inline uint8_t op(uint8_t a, uint8_t b) { return a | b; }
+  static inline uint64_t op(uint64_t a, uint64_t b) { return a | b; }
+#if defined(BUFFERTOOLS_SSE2)
+  static inline __m128i op(__m128i a, __m128i b) {
+    return _mm_or_si128(a, b);
+  }
+#endif
+#if defined(BUFFERTOOLS_X86)
+  BUFFERTOOLS_TARGET("avx2")
+  static inline __m256i op(__m256i a, __m256i b) {
+    return _mm256_or_si256(a, b);
+  }
+#endif
+};
+
+struct bitwise_xor {
+  static inline uint8_t op(uint8_t a, uint8_t b) { return a ^ b; }
+  static inline uint64_t op(uint64_t a, uint64_t b) { return a ^ b; }
+#if defined(BUFFERTOOLS_SSE2)
+  static inline __m128i op(__m128i a, __m128i b) {
+    return _mm_xor_si128(a, b);
+  }
+#endif
+#if defined(BUFFERTOOLS_X86)
+  BUFFERTOOLS_TARGET("avx2")
+  static inline __m256i op(__m256i a, __m256i b) {
+    return _mm256_xor_si256(a, b);
+  }
+#endif
+};
+
+// Portable fallback, also used for the tails that the SIMD loops leave.
+// memcpy() compiles to plain unaligned loads and stores.
+template <class Op>
+static void bitwise_block_scalar(uint8_t* dst,
+                                 const uint8_t* src,
+                                 const uint8_t* operand,
+                                 size_t size) {
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t a, b;
+    memcpy(&a, src + i, 8);
+    memcpy(&b, operand + i, 8);
+    a = Op::op(a, b);
+    memcpy(dst + i, &a, 8);
+  }
+  for (; i < size; ++i) {
+    dst[i] = Op::op(src[i], operand[i]);
+  }
+}
+
+#if defined(BUFFERTOOLS_SSE2)
+template <class Op>
+static void bitwise_block_sse2(uint8_t* dst,
+                               const uint8_t* src,
+                               const uint8_t* operand,
+                               size_t size) {
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    const __m128i a = _mm_loadu_si128((const __m128i*) (src + i));
+    const __m128i b = _mm_loadu_si128((const __m128i*) (operand + i));
+    _mm_storeu_si128((__m128i*) (dst + i), Op::op(a, b));
+  }
+  bitwise_block_scalar<Op>(dst + i, src + i, operand + i, size - i);
+}
+#endif  // BUFFERTOOLS_SSE2
+
+#if defined(BUFFERTOOLS_X86)
+template <class Op>
+BUFFERTOOLS_TARGET("avx2")
+static void bitwise_block_avx2(uint8_t* dst,
+                               const uint8_t* src,
+                               const uint8_t* operand,
+                               size_t size) {
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    const __m256i a = _mm256_loadu_si256((const __m256i*) (src + i));
+    const __m256i b = _mm256_loadu_si256((const __m256i*) (operand + i));
+    _mm256_storeu_si256((__m256i*) (dst + i), Op::op(a, b));
+  }
+  bitwise_block_scalar<Op>(dst + i, src + i, operand + i, size - i);
+}
+#endif  // BUFFERTOOLS_X86
+
+template <class Op>
+static inline void bitwise_block(uint8_t* dst,
+                                 const uint8_t* src,
+                                 const uint8_t* operand,
+                                 size_t size) {
+#if defined(BUFFERTOOLS_X86)
+  if (cpu_has(CPU_AVX2)) {
+    bitwise_block_avx2<Op>(dst, src, operand, size);
+    return;
+  }
+#endif
+#if defined(BUFFERTOOLS_SSE2)
+  bitwise_block_sse2<Op>(dst, src, operand, size);
+#else
+  bitwise_block_scalar<Op>(dst, src, operand, size);
+#endif
+}
+
+// |operand_size| must be greater than zero.
+template <class Op>
+static void bitwise(uint8_t* dst,
+                    const uint8_t* src,
+                    size_t size,
+                    const uint8_t* operand,
+                    size_t operand_size) {
+  uint8_t block[BITWISE_BLOCK_SIZE];
+  uint8_t* copy = NULL;
+  size_t block_size = operand_size;
+
+  if (operand_size < size && operand_size * 2 <= BITWISE_BLOCK_SIZE) {
+    block_size = BITWISE_BLOCK_SIZE - BITWISE_BLOCK_SIZE % operand_size;
+    for (size_t i = 0; i < block_size; i += operand_size) {
+      memcpy(block + i, operand, operand_size);
+    }
+    operand = block;
+  } else if (operand < dst + size && dst < operand + operand_size &&
+             !(operand == dst && operand_size >= size)) {
+    // The operand overlaps the output and would be changed by the time
+    // it's read, work from a copy.
+    if (operand_size > size) {
+      operand_size = size;
+    }
+    copy = new uint8_t[operand_size];
+    memcpy(copy, operand, operand_size);
+    operand = copy;
+  }
+
+  // A target that starts inside the source overwrites bytes before they
+  // are read. Working front to back is only safe when it starts at or
+  // before the source, like memmove().
+  uint8_t* src_copy = NULL;
+  if (src < dst && dst < src + size) {
+    src_copy = new uint8_t[size];
+    memcpy(src_copy, src, size);
+    src = src_copy;
+  }
+
+  for (size_t i = 0; i < size; i += block_size) {
+    const size_t n = size - i < block_size ? size - i : block_size;
+    bitwise_block<Op>(dst + i, src + i, operand, n);
+  }
+
+  delete[] src_copy;
+  delete[] copy;
+}
+
+#endif  // BITWISE_H
@@ -2,6 +2,9 @@
 #ifndef BOYER_MOORE_H
 #define BOYER_MOORE_H
 
+#include "Stats.h"
+
+#include <stddef.h>
 #include <stdint.h>
 #include <limits.h>
 #include <string.h>
@@ -71,9 +74,59 @@ void prepare_goodsuffix_heuristic(const uint8_t *normal, const size_t size, int
 }
 
 /*
-* Boyer-Moore search algorithm
+* Precomputed heuristics for one needle, reusable across searches.
+* The table owns a copy of the needle; free it with boyermoore_release().
+* A reverse table holds the needle and heuristics in mirrored order and
+* is used for right-to-left searches.
 */
-const uint8_t *boyermoore_search(const uint8_t *haystack, size_t haystack_len, const uint8_t *needle, size_t needle_len) {
+struct boyermoore_table {
+	uint8_t *needle;
+	size_t needle_len;
+	int reverse;
+	int badcharacter[ALPHABET_SIZE];
+	int *goodsuffix;
+};
+
+static void boyermoore_prepare(struct boyermoore_table *table, const uint8_t *needle, size_t needle_len, int reverse) {
+	size_t i;
+
+	table->needle = new uint8_t[stats_allocation(needle_len+1)];
+	table->needle_len = needle_len;
+	table->reverse = reverse;
+	table->goodsuffix = new int[needle_len+1];
+	stats_allocation((needle_len+1) * sizeof(int));
+
+	if (reverse) {
+		for (i = 0; i < needle_len; i++)
+			table->needle[i] = needle[needle_len-1-i];
+	} else if (needle_len > 0) {
+		memcpy(table->needle, needle, needle_len);
+	}
+
+	if (needle_len == 0)
+		return;
+
+	prepare_badcharacter_heuristic(table->needle, needle_len, table->badcharacter);
+	prepare_goodsuffix_heuristic(table->needle, needle_len, table->goodsuffix);
+}
+
+static void boyermoore_release(struct boyermoore_table *table) {
+	delete[] table->needle;
+	delete[] table->goodsuffix;
+	table->needle = NULL;
+	table->goodsuffix = NULL;
+}
+
+/*
+* Boyer-Moore search with precomputed heuristics. Reverse tables scan the
+* haystack as if it were mirrored and so find the last occurrence.
+* The reverse flag is passed as a constant so each direction gets its own
+* inlined loop.
+*/
+static inline const uint8_t *boyermoore_scan(const struct boyermoore_table *table, const uint8_t *haystack, size_t haystack_len, const int reverse) {
+	const uint8_t *needle = table->needle;
+	const size_t needle_len = table->needle_len;
+
 	/*
 	* Simple checks
 	*/
@@ -85,43 +138,73 @@ const uint8_t *boyermoore_search(const uint8_t *haystack, size_t haystack_len, c
 		return NULL;
 
 	/*
-	* Initialize heuristics
+	* Mirror the haystack for reverse searches: position i of the
+	* mirrored haystack is position (haystack_len-1-i) of the real one.
 	*/
-	int badcharacter[ALPHABET_SIZE];
-	int * goodsuffix = new int[needle_len+1];
-
-	prepare_badcharacter_heuristic(needle, needle_len, badcharacter);
-	prepare_goodsuffix_heuristic(needle, needle_len, goodsuffix);
+	const uint8_t *last = haystack + haystack_len - 1;
+#define HAYSTACK(i) (reverse ? last[-(ptrdiff_t)(i)] : haystack[i])
 
-	/*
-	* Boyer-Moore search
-	*/
 	size_t s = 0;
 	while(s <= (haystack_len - needle_len))
 	{
 		size_t j = needle_len;
-		while(j > 0 && needle[j-1] == haystack[s+j-1])
+		while(j > 0 && needle[j-1] == HAYSTACK(s+j-1))
 			j--;
 
 		if(j > 0)
 		{
-			int k = badcharacter[haystack[s+j-1]];
+			int k = table->badcharacter[HAYSTACK(s+j-1)];
 			int m;
-			if(k < (int)j && (m = j-k-1) > goodsuffix[j])
+			if(k < (int)j && (m = j-k-1) > table->goodsuffix[j])
 				s+= m;
 			else
-				s+= goodsuffix[j];
+				s+= table->goodsuffix[j];
+		}
+		else if (reverse)
+		{
+			return haystack + haystack_len - s - needle_len;
 		}
 		else
 		{
-			delete[] goodsuffix;
 			return haystack + s;
 		}
 	}
+#undef HAYSTACK
 
-	delete[] goodsuffix;
 	/* not found */
 	return NULL;
 }
 
+static const uint8_t *boyermoore_search_table(const struct boyermoore_table *table, const uint8_t *haystack, size_t haystack_len) {
+	if (table->reverse)
+		return boyermoore_scan(table, haystack, haystack_len, 1);
+	return boyermoore_scan(table, haystack, haystack_len, 0);
+}
+
+/*
+* Boyer-Moore search algorithm
+*/
+const uint8_t *boyermoore_search(const uint8_t *haystack, size_t haystack_len, const uint8_t *needle, size_t needle_len) {
+	/*
+	* Simple checks
+	*/
+	if(haystack_len == 0)
+		return NULL;
+	if(needle_len == 0)
+		return NULL;
+	if(needle_len > haystack_len)
+		return NULL;
+
+	/*
+	* Initialize heuristics
+	*/
+	struct boyermoore_table table;
+	boyermoore_prepare(&table, needle, needle_len, 0);
+
+	const uint8_t *p = boyermoore_search_table(&table, haystack, haystack_len);
+	boyermoore_release(&table);
+
+	return p;
+}
+
 #endif	/* BoyerMoore.h */
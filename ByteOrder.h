@@ -0,0 +1,254 @@
+/* Copyright (c) 2010, Ben Noordhuis <info@bnoordhuis.nl>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BYTE_ORDER_H
+#define BYTE_ORDER_H
+
+#include "CpuFeatures.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// In-place byte reversal of a whole buffer and of every 2, 4 or 8 byte
+// element in it (endianness conversion).
+//
+// reverse_bytes() swaps a block from the head with a block from the tail,
+// 32, 16 or 8 bytes at a time, so both ends are walked sequentially with
+// whole-word loads and stores instead of one byte per iteration.
+// byteswap() expects |size| to be a multiple of |width|.
+
+// Compilers turn these into bswap instructions.
+static inline uint16_t bswap16(uint16_t x) {
+  return (uint16_t) ((x << 8) | (x >> 8));
+}
+
+static inline uint32_t bswap32(uint32_t x) {
+  return ((uint32_t) bswap16((uint16_t) x) << 16) |
+         bswap16((uint16_t) (x >> 16));
+}
+
+static inline uint64_t bswap64(uint64_t x) {
+  return ((uint64_t) bswap32((uint32_t) x) << 32) |
+         bswap32((uint32_t) (x >> 32));
+}
+
+// Portable fallbacks, also used for the tails that the SIMD loops leave.
+static inline void reverse_scalar(uint8_t* data, size_t size) {
+  uint8_t* head = data;
+  uint8_t* tail = data + size;
+
+  while (tail - head >= 16) {
+    uint64_t a, b;
+    tail -= 8;
+    memcpy(&a, head, 8);
+    memcpy(&b, tail, 8);
+    a = bswap64(a);
+    b = bswap64(b);
+    memcpy(head, &b, 8);
+    memcpy(tail, &a, 8);
+    head += 8;
+  }
+
+  while (head < tail) {
+    --tail;
+    uint8_t t = *head;
+    *head = *tail;
+    *tail = t;
+    ++head;
+  }
+}
+
+static inline void byteswap16_scalar(uint8_t* data, size_t size) {
+  for (size_t i = 0; i < size; i += 2) {
+    uint16_t x;
+    memcpy(&x, data + i, 2);
+    x = bswap16(x);
+    memcpy(data + i, &x, 2);
+  }
+}
+
+static inline void byteswap32_scalar(uint8_t* data, size_t size) {
+  for (size_t i = 0; i < size; i += 4) {
+    uint32_t x;
+    memcpy(&x, data + i, 4);
+    x = bswap32(x);
+    memcpy(data + i, &x, 4);
+  }
+}
+
+static inline void byteswap64_scalar(uint8_t* data, size_t size) {
+  for (size_t i = 0; i < size; i += 8) {
+    uint64_t x;
+    memcpy(&x, data + i, 8);
+    x = bswap64(x);
+    memcpy(data + i, &x, 8);
+  }
+}
+
+static inline void byteswap_scalar(uint8_t* data, size_t size, size_t width) {
+  if (width == 2) {
+    byteswap16_scalar(data, size);
+  } else if (width == 4) {
+    byteswap32_scalar(data, size);
+  } else {
+    byteswap64_scalar(data, size);
+  }
+}
+
+#if defined(BUFFERTOOLS_SSE2)
+// SSE2 has no byte shuffle, build the swaps out of word shuffles and shifts.
+static inline __m128i bswap16_sse2(__m128i x) {
+  return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+static inline __m128i bswap32_sse2(__m128i x) {
+  x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xb1), 0xb1);
+  return bswap16_sse2(x);
+}
+
+static inline __m128i bswap64_sse2(__m128i x) {
+  x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0x1b), 0x1b);
+  return bswap16_sse2(x);
+}
+
+static inline __m128i bswap128_sse2(__m128i x) {
+  return bswap64_sse2(_mm_shuffle_epi32(x, 0x4e));
+}
+
+static void reverse_sse2(uint8_t* data, size_t size) {
+  uint8_t* head = data;
+  uint8_t* tail = data + size;
+
+  while (tail - head >= 32) {
+    tail -= 16;
+    const __m128i a = _mm_loadu_si128((const __m128i*) head);
+    const __m128i b = _mm_loadu_si128((const __m128i*) tail);
+    _mm_storeu_si128((__m128i*) head, bswap128_sse2(b));
+    _mm_storeu_si128((__m128i*) tail, bswap128_sse2(a));
+    head += 16;
+  }
+
+  reverse_scalar(head, tail - head);
+}
+
+static void byteswap_sse2(uint8_t* data, size_t size, size_t width) {
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*) (data + i));
+    if (width == 2) {
+      x = bswap16_sse2(x);
+    } else if (width == 4) {
+      x = bswap32_sse2(x);
+    } else {
+      x = bswap64_sse2(x);
+    }
+    _mm_storeu_si128((__m128i*) (data + i), x);
+  }
+  byteswap_scalar(data + i, size - i, width);
+}
+#endif  // BUFFERTOOLS_SSE2
+
+#if defined(BUFFERTOOLS_X86)
+// pshufb masks that reverse 2, 4, 8 and 16 bytes, per 128 bits lane.
+BUFFERTOOLS_TARGET("avx2")
+static inline __m256i byteswap_mask_avx2(size_t width) {
+  if (width == 2) {
+    return _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+                            9, 8, 11, 10, 13, 12, 15, 14,
+                            1, 0, 3, 2, 5, 4, 7, 6,
+                            9, 8, 11, 10, 13, 12, 15, 14);
+  }
+  if (width == 4) {
+    return _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+                            11, 10, 9, 8, 15, 14, 13, 12,
+                            3, 2, 1, 0, 7, 6, 5, 4,
+                            11, 10, 9, 8, 15, 14, 13, 12);
+  }
+  if (width == 8) {
+    return _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0,
+                            15, 14, 13, 12, 11, 10, 9, 8,
+                            7, 6, 5, 4, 3, 2, 1, 0,
+                            15, 14, 13, 12, 11, 10, 9, 8);
+  }
+  return _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8,
+                          7, 6, 5, 4, 3, 2, 1, 0,
+                          15, 14, 13, 12, 11, 10, 9, 8,
+                          7, 6, 5, 4, 3, 2, 1, 0);
+}
+
+BUFFERTOOLS_TARGET("avx2")
+static void reverse_avx2(uint8_t* data, size_t size) {
+  const __m256i mask = byteswap_mask_avx2(16);
+  uint8_t* head = data;
+  uint8_t* tail = data + size;
+
+  while (tail - head >= 64) {
+    tail -= 32;
+    const __m256i a = _mm256_loadu_si256((const __m256i*) head);
+    const __m256i b = _mm256_loadu_si256((const __m256i*) tail);
+    // Reverse each lane, then swap the lanes.
+    _mm256_storeu_si256((__m256i*) head, _mm256_permute4x64_epi64(
+        _mm256_shuffle_epi8(b, mask), 0x4e));
+    _mm256_storeu_si256((__m256i*) tail, _mm256_permute4x64_epi64(
+        _mm256_shuffle_epi8(a, mask), 0x4e));
+    head += 32;
+  }
+
+  reverse_scalar(head, tail - head);
+}
+
+BUFFERTOOLS_TARGET("avx2")
+static void byteswap_avx2(uint8_t* data, size_t size, size_t width) {
+  const __m256i mask = byteswap_mask_avx2(width);
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    const __m256i x = _mm256_loadu_si256((const __m256i*) (data + i));
+    _mm256_storeu_si256((__m256i*) (data + i), _mm256_shuffle_epi8(x, mask));
+  }
+  byteswap_scalar(data + i, size - i, width);
+}
+#endif  // BUFFERTOOLS_X86
+
+static inline void reverse_bytes(uint8_t* data, size_t size) {
+#if defined(BUFFERTOOLS_X86)
+  if (cpu_has(CPU_AVX2)) {
+    reverse_avx2(data, size);
+    return;
+  }
+#endif
+#if defined(BUFFERTOOLS_SSE2)
+  reverse_sse2(data, size);
+#else
+  reverse_scalar(data, size);
+#endif
+}
+
+// |width| must be 2, 4 or 8.
+static inline void byteswap(uint8_t* data, size_t size, size_t width) {
+#if defined(BUFFERTOOLS_X86)
+  if (cpu_has(CPU_AVX2)) {
+    byteswap_avx2(data, size, width);
+    return;
+  }
+#endif
+#if defined(BUFFERTOOLS_SSE2)
+  byteswap_sse2(data, size, width);
+#else
+  byteswap_scalar(data, size, width);
+#endif
+}
+
+#endif  // BYTE_ORDER_H
@@ -0,0 +1,291 @@
+/* Copyright (c) 2010, Ben Noordhuis <info@bnoordhuis.nl>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef COMPARE_H
+#define COMPARE_H
+
+#include "ByteOrder.h"
+#include "CpuFeatures.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Byte-wise comparison of two ranges of the same size:
+//
+//  - mem_compare() orders them like memcmp() but returns -1, 0 or 1,
+//  - mem_equal() only tells if they're equal,
+//  - mem_equal_constant_time() does the same in a time that depends on the
+//    size alone, not on where the first difference is. Use it for secrets.
+//
+// The first two stop at the first block of 64, 16 or 8 bytes that differs.
+// A tail that doesn't fill a whole block is compared with one more block
+// that overlaps the bytes before it, those are known to be equal already.
+// The constant time version ORs the XOR of every block into an accumulator
+// and looks at that once, at the end.
+
+// Loads 8 bytes in big endian order, so that comparing two loads as numbers
+// orders them the same as comparing the bytes one by one.
+static inline uint64_t compare_load64(const uint8_t* p) {
+  uint64_t x;
+  memcpy(&x, p, 8);
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
+  x = bswap64(x);
+#endif
+  return x;
+}
+
+// The order of the bytes at |k|, the first that differ.
+static inline int compare_at(const uint8_t* a, const uint8_t* b, size_t k) {
+  return a[k] < b[k] ? -1 : 1;
+}
+
+static inline int mem_compare_scalar(const uint8_t* a,
+                                     const uint8_t* b,
+                                     size_t size) {
+  if (size >= 8) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+      const uint64_t x = compare_load64(a + i);
+      const uint64_t y = compare_load64(b + i);
+      if (x != y) {
+        return x < y ? -1 : 1;
+      }
+    }
+    if (i < size) {
+      const uint64_t x = compare_load64(a + size - 8);
+      const uint64_t y = compare_load64(b + size - 8);
+      if (x != y) {
+        return x < y ? -1 : 1;
+      }
+    }
+    return 0;
+  }
+
+  for (size_t i = 0; i < size; ++i) {
+    if (a[i] != b[i]) {
+      return compare_at(a, b, i);
+    }
+  }
+  return 0;
+}
+
+static inline bool mem_equal_constant_time_scalar(const uint8_t* a,
+                                                  const uint8_t* b,
+                                                  size_t size) {
+  uint64_t acc = 0;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t x, y;
+    memcpy(&x, a + i, 8);
+    memcpy(&y, b + i, 8);
+    acc |= x ^ y;
+  }
+  for (; i < size; ++i) {
+    acc |= a[i] ^ b[i];
+  }
+  return acc == 0;
+}
+
+#if defined(BUFFERTOOLS_SSE2)
+static int mem_compare_sse2(const uint8_t* a, const uint8_t* b, size_t size) {
+  if (size < 16) {
+    return mem_compare_scalar(a, b, size);
+  }
+
+  size_t i = 0;
+  for (;;) {
+    const __m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+    const __m128i y = _mm_loadu_si128((const __m128i*) (b + i));
+    const unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+    if (mask != 0xffff) {
+      return compare_at(a, b, i + BUFFERTOOLS_CTZ(~mask));
+    }
+    if (i + 16 == size) {
+      return 0;
+    }
+    i = i + 32 <= size ? i + 16 : size - 16;
+  }
+}
+
+static bool mem_equal_sse2(const uint8_t* a, const uint8_t* b, size_t size) {
+  if (size < 16) {
+    return mem_compare_scalar(a, b, size) == 0;
+  }
+
+  size_t i = 0;
+  for (;;) {
+    const __m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+    const __m128i y = _mm_loadu_si128((const __m128i*) (b + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xffff) {
+      return false;
+    }
+    if (i + 16 == size) {
+      return true;
+    }
+    i = i + 32 <= size ? i + 16 : size - 16;
+  }
+}
+
+static bool mem_equal_constant_time_sse2(const uint8_t* a,
+                                         const uint8_t* b,
+                                         size_t size) {
+  __m128i acc = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    const __m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+    const __m128i y = _mm_loadu_si128((const __m128i*) (b + i));
+    acc = _mm_or_si128(acc, _mm_xor_si128(x, y));
+  }
+  const bool tail = mem_equal_constant_time_scalar(a + i, b + i, size - i);
+  const bool head =
+      _mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) == 0xffff;
+  return head & tail;
+}
+#endif  // BUFFERTOOLS_SSE2
+
+#if defined(BUFFERTOOLS_X86)
+BUFFERTOOLS_TARGET("avx2")
+static int mem_compare_avx2(const uint8_t* a, const uint8_t* b, size_t size) {
+  size_t i = 0;
+  for (; i + 64 <= size; i += 64) {
+    const __m256i eq0 = _mm256_cmpeq_epi8(
+        _mm256_loadu_si256((const __m256i*) (a + i)),
+        _mm256_loadu_si256((const __m256i*) (b + i)));
+    const __m256i eq1 = _mm256_cmpeq_epi8(
+        _mm256_loadu_si256((const __m256i*) (a + i + 32)),
+        _mm256_loadu_si256((const __m256i*) (b + i + 32)));
+    if ((unsigned) _mm256_movemask_epi8(_mm256_and_si256(eq0, eq1)) !=
+        0xffffffff) {
+      const unsigned mask0 = _mm256_movemask_epi8(eq0);
+      if (mask0 != 0xffffffff) {
+        return compare_at(a, b, i + BUFFERTOOLS_CTZ(~mask0));
+      }
+      const unsigned mask1 = _mm256_movemask_epi8(eq1);
+      return compare_at(a, b, i + 32 + BUFFERTOOLS_CTZ(~mask1));
+    }
+  }
+
+  if (size < 32) {
+    return mem_compare_scalar(a, b, size);
+  }
+  while (i < size) {
+    if (i + 32 > size) {
+      i = size - 32;
+    }
+    const __m256i eq = _mm256_cmpeq_epi8(
+        _mm256_loadu_si256((const __m256i*) (a + i)),
+        _mm256_loadu_si256((const __m256i*) (b + i)));
+    const unsigned mask = _mm256_movemask_epi8(eq);
+    if (mask != 0xffffffff) {
+      return compare_at(a, b, i + BUFFERTOOLS_CTZ(~mask));
+    }
+    i += 32;
+  }
+  return 0;
+}
+
+BUFFERTOOLS_TARGET("avx2")
+static bool mem_equal_avx2(const uint8_t* a, const uint8_t* b, size_t size) {
+  size_t i = 0;
+  for (; i + 64 <= size; i += 64) {
+    const __m256i d0 = _mm256_xor_si256(
+        _mm256_loadu_si256((const __m256i*) (a + i)),
+        _mm256_loadu_si256((const __m256i*) (b + i)));
+    const __m256i d1 = _mm256_xor_si256(
+        _mm256_loadu_si256((const __m256i*) (a + i + 32)),
+        _mm256_loadu_si256((const __m256i*) (b + i + 32)));
+    const __m256i d = _mm256_or_si256(d0, d1);
+    if (!_mm256_testz_si256(d, d)) {
+      return false;
+    }
+  }
+
+  if (size < 32) {
+    return mem_compare_scalar(a, b, size) == 0;
+  }
+  while (i < size) {
+    if (i + 32 > size) {
+      i = size - 32;
+    }
+    const __m256i d = _mm256_xor_si256(
+        _mm256_loadu_si256((const __m256i*) (a + i)),
+        _mm256_loadu_si256((const __m256i*) (b + i)));
+    if (!_mm256_testz_si256(d, d)) {
+      return false;
+    }
+    i += 32;
+  }
+  return true;
+}
+
+BUFFERTOOLS_TARGET("avx2")
+static bool mem_equal_constant_time_avx2(const uint8_t* a,
+                                         const uint8_t* b,
+                                         size_t size) {
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    const __m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+    const __m256i y = _mm256_loadu_si256((const __m256i*) (b + i));
+    acc = _mm256_or_si256(acc, _mm256_xor_si256(x, y));
+  }
+  const bool tail = mem_equal_constant_time_scalar(a + i, b + i, size - i);
+  return _mm256_testz_si256(acc, acc) & tail;
+}
+#endif  // BUFFERTOOLS_X86
+
+static inline int mem_compare(const uint8_t* a, const uint8_t* b, size_t size) {
+#if defined(BUFFERTOOLS_X86)
+  if (cpu_has(CPU_AVX2)) {
+    return mem_compare_avx2(a, b, size);
+  }
+#endif
+#if defined(BUFFERTOOLS_SSE2)
+  return mem_compare_sse2(a, b, size);
+#else
+  return mem_compare_scalar(a, b, size);
+#endif
+}
+
+static inline bool mem_equal(const uint8_t* a, const uint8_t* b, size_t size) {
+#if defined(BUFFERTOOLS_X86)
+  if (cpu_has(CPU_AVX2)) {
+    return mem_equal_avx2(a, b, size);
+  }
+#endif
+#if defined(BUFFERTOOLS_SSE2)
+  return mem_equal_sse2(a, b, size);
+#else
+  return mem_compare_scalar(a, b, size) == 0;
+#endif
+}
+
+static inline bool mem_equal_constant_time(const uint8_t* a,
+                                           const uint8_t* b,
+                                           size_t size) {
+#if defined(BUFFERTOOLS_X86)
+  if (cpu_has(CPU_AVX2)) {
+    return mem_equal_constant_time_avx2(a, b, size);
+  }
+#endif
+#if defined(BUFFERTOOLS_SSE2)
+  return mem_equal_constant_time_sse2(a, b, size);
+#else
+  return mem_equal_constant_time_scalar(a, b, size);
+#endif
+}
+
+#endif  // COMPARE_H
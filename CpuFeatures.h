@@ -0,0 +1,63 @@
+/* Copyright (c) 2010, Ben Noordhuis <info@bnoordhuis.nl>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// The SIMD kernels are written with GCC/clang intrinsics and per-function
+// target attributes, so the module itself can be compiled for the baseline
+// instruction set and still use AVX2 et al. when the CPU supports it.
+// Everything else gets the portable scalar code.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define BUFFERTOOLS_X86 1
+# include <immintrin.h>
+# define BUFFERTOOLS_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#if defined(BUFFERTOOLS_X86) && defined(__SSE2__)
+# define BUFFERTOOLS_SSE2 1
+#endif
+
+#if defined(__GNUC__)
+# define BUFFERTOOLS_CTZ(x) __builtin_ctz(x)
+# define BUFFERTOOLS_CLZ(x) __builtin_clz(x)
+#endif
+
+enum {
+  CPU_SSE2 = 1,
+  CPU_SSSE3 = 2,
+  CPU_SSE42 = 4,
+  CPU_AVX2 = 8
+};
+
+static inline unsigned detect_cpu_features() {
+  unsigned features = 0;
+#if defined(BUFFERTOOLS_X86)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2")) features |= CPU_SSE2;
+  if (__builtin_cpu_supports("ssse3")) features |= CPU_SSSE3;
+  if (__builtin_cpu_supports("sse4.2")) features |= CPU_SSE42;
+  if (__builtin_cpu_supports("avx2")) features |= CPU_AVX2;
+#endif
+  return features;
+}
+
+// Detected once, on first use.
+static inline bool cpu_has(unsigned feature) {
+  static const unsigned features = detect_cpu_features();
+  return (features & feature) == feature;
+}
+
+#endif  // CPU_FEATURES_H
@@ -0,0 +1,127 @@
+/* Copyright (c) 2010, Ben Noordhuis <info@bnoordhuis.nl>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef FILL_H
+#define FILL_H
+
+#include "CpuFeatures.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Fills a range with copies of a pattern, the last copy is truncated.
+//
+// The pattern is written once, then the filled prefix is copied onto the
+// bytes that follow it, which doubles the filled part with every memcpy()
+// until it's FILL_BLOCK bytes or more. The rest of the range is filled with
+// copies of that block, a source that stays in the cache. Filling 1 GB with
+// a 3 byte pattern takes some 60,000 big copies instead of 333 million tiny
+// ones.
+//
+// With |nontemporal| set, the block copies use non-temporal stores that
+// bypass the cache, so filling a big arena doesn't evict the working set.
+// fill_pattern() sets it for ranges of FILL_NONTEMPORAL_THRESHOLD bytes
+// or more.
+#define FILL_BLOCK (16 * 1024)
+#define FILL_NONTEMPORAL_THRESHOLD (8 * 1024 * 1024)
+
+#if defined(BUFFERTOOLS_SSE2)
+// Copies |size| bytes with streaming stores. Only the stores need to be
+// aligned, the head and the tail are copied normally.
+static inline void fill_copy_nontemporal(uint8_t* dst,
+                                         const uint8_t* src,
+                                         size_t size) {
+  size_t i = (16 - ((uintptr_t) dst & 15)) & 15;
+  if (i > size) {
+    i = size;
+  }
+  memcpy(dst, src, i);
+  for (; i + 64 <= size; i += 64) {
+    const __m128i a = _mm_loadu_si128((const __m128i*) (src + i));
+    const __m128i b = _mm_loadu_si128((const __m128i*) (src + i + 16));
+    const __m128i c = _mm_loadu_si128((const __m128i*) (src + i + 32));
+    const __m128i d = _mm_loadu_si128((const __m128i*) (src + i + 48));
+    _mm_stream_si128((__m128i*) (dst + i), a);
+    _mm_stream_si128((__m128i*) (dst + i + 16), b);
+    _mm_stream_si128((__m128i*) (dst + i + 32), c);
+    _mm_stream_si128((__m128i*) (dst + i + 48), d);
+  }
+  for (; i + 16 <= size; i += 16) {
+    const __m128i a = _mm_loadu_si128((const __m128i*) (src + i));
+    _mm_stream_si128((__m128i*) (dst + i), a);
+  }
+  memcpy(dst + i, src + i, size - i);
+}
+#endif  // BUFFERTOOLS_SSE2
+
+static inline void fill_pattern_ex(uint8_t* data,
+                                   size_t length,
+                                   const void* pattern,
+                                   size_t size,
+                                   bool nontemporal) {
+  if (size == 0 || length == 0) {
+    return;
+  }
+
+  if (size >= length) {
+    memmove(data, pattern, length);
+    return;
+  }
+
+  memmove(data, pattern, size);
+  size_t filled = size;
+  while (filled < FILL_BLOCK && filled < length - filled) {
+    memcpy(data + filled, data, filled);
+    filled *= 2;
+  }
+
+  // |filled| is a whole number of patterns, so every block starts with
+  // the first byte of the pattern.
+  const size_t block = filled;
+  while (filled < length) {
+    const size_t n = length - filled < block ? length - filled : block;
+#if defined(BUFFERTOOLS_SSE2)
+    if (nontemporal) {
+      fill_copy_nontemporal(data + filled, data, n);
+    } else {
+      memcpy(data + filled, data, n);
+    }
+#else
+    memcpy(data + filled, data, n);
+#endif
+    filled += n;
+  }
+
+#if defined(BUFFERTOOLS_SSE2)
+  if (nontemporal) {
+    _mm_sfence();  // Make the streaming stores visible to other threads.
+  }
+#endif
+}
+
+// Doesn't touch V8 so it can run on the thread pool.
+static inline void fill_pattern(uint8_t* data,
+                                size_t length,
+                                const void* pattern,
+                                size_t size) {
+  fill_pattern_ex(data,
+                  length,
+                  pattern,
+                  size,
+                  length >= FILL_NONTEMPORAL_THRESHOLD);
+}
+
+#endif  // FILL_H
@@ -0,0 +1,269 @@
+/* Copyright (c) 2010, Ben Noordhuis <info@bnoordhuis.nl>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include "CpuFeatures.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Non-cryptographic checksums and hashes:
+//
+//  - CRC-32C (Castagnoli), with the SSE4.2 crc32 instruction when the CPU
+//    has it and slicing-by-8 tables otherwise,
+//  - xxHash64, which reads 32 bytes per round in four independent lanes.
+//
+// Both can be computed incrementally. crc32c() continues from the CRC of
+// the data that came before, xxh64_update() adds data to a running state.
+
+static inline uint32_t hash_read32(const uint8_t* p) {
+  uint32_t x;
+  memcpy(&x, p, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  x = __builtin_bswap32(x);
+#endif
+  return x;
+}
+
+static inline uint64_t hash_read64(const uint8_t* p) {
+  uint64_t x;
+  memcpy(&x, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  x = __builtin_bswap64(x);
+#endif
+  return x;
+}
+
+//
+// CRC-32C
+//
+#define CRC32C_POLYNOMIAL 0x82f63b78  // reversed
+
+struct crc32c_tables {
+  uint32_t table[8][256];
+};
+
+static inline const crc32c_tables* crc32c_tables_create() {
+  static crc32c_tables tables;
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (int k = 0; k < 8; ++k) {
+      crc = (crc >> 1) ^ (CRC32C_POLYNOMIAL & (0 - (crc & 1)));
+    }
+    tables.table[0][i] = crc;
+  }
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = tables.table[0][i];
+    for (int t = 1; t < 8; ++t) {
+      crc = tables.table[0][crc & 0xff] ^ (crc >> 8);
+      tables.table[t][i] = crc;
+    }
+  }
+  return &tables;
+}
+
+// Portable fallback, eight bytes per step. |crc| is the raw register,
+// without the pre and post inversion.
+static inline uint32_t crc32c_update_scalar(uint32_t crc,
+                                            const uint8_t* data,
+                                            size_t size) {
+  static const crc32c_tables* const tables = crc32c_tables_create();
+  const uint32_t (*t)[256] = tables->table;
+
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    const uint32_t lo = hash_read32(data + i) ^ crc;
+    const uint32_t hi = hash_read32(data + i + 4);
+    crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^
+          t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^
+          t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+  }
+  for (; i < size; ++i) {
+    crc = t[0][(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if defined(BUFFERTOOLS_X86)
+BUFFERTOOLS_TARGET("sse4.2")
+static uint32_t crc32c_update_sse42(uint32_t crc,
+                                    const uint8_t* data,
+                                    size_t size) {
+  size_t i = 0;
+#if defined(__x86_64__)
+  uint64_t crc64 = crc;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t x;
+    memcpy(&x, data + i, 8);
+    crc64 = _mm_crc32_u64(crc64, x);
+  }
+  crc = (uint32_t) crc64;
+#endif
+  for (; i + 4 <= size; i += 4) {
+    uint32_t x;
+    memcpy(&x, data + i, 4);
+    crc = _mm_crc32_u32(crc, x);
+  }
+  for (; i < size; ++i) {
+    crc = _mm_crc32_u8(crc, data[i]);
+  }
+  return crc;
+}
+#endif  // BUFFERTOOLS_X86
+
+// Returns the CRC of |data| appended to data whose CRC is |prev|. Start
+// with a |prev| of zero.
+static inline uint32_t crc32c(uint32_t prev, const uint8_t* data, size_t size) {
+#if defined(BUFFERTOOLS_X86)
+  if (cpu_has(CPU_SSE42)) {
+    return ~crc32c_update_sse42(~prev, data, size);
+  }
+#endif
+  return ~crc32c_update_scalar(~prev, data, size);
+}
+
+//
+// xxHash64
+//
+#define XXH64_PRIME1 0x9e3779b185ebca87ULL
+#define XXH64_PRIME2 0xc2b2ae3d27d4eb4fULL
+#define XXH64_PRIME3 0x165667b19e3779f9ULL
+#define XXH64_PRIME4 0x85ebca77c2b2ae63ULL
+#define XXH64_PRIME5 0x27d4eb2f165667c5ULL
+
+struct xxh64_state {
+  uint64_t seed;
+  uint64_t total;
+  uint64_t lanes[4];
+  uint8_t buffer[32];  // an incomplete stripe
+  size_t buffered;
+};
+
+static inline uint64_t xxh64_rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t xxh64_round(uint64_t lane, uint64_t input) {
+  lane += input * XXH64_PRIME2;
+  lane = xxh64_rotl(lane, 31);
+  return lane * XXH64_PRIME1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t hash, uint64_t lane) {
+  hash ^= xxh64_round(0, lane);
+  return hash * XXH64_PRIME1 + XXH64_PRIME4;
+}
+
+static inline void xxh64_init(xxh64_state* state, uint64_t seed) {
+  state->seed = seed;
+  state->total = 0;
+  state->lanes[0] = seed + XXH64_PRIME1 + XXH64_PRIME2;
+  state->lanes[1] = seed + XXH64_PRIME2;
+  state->lanes[2] = seed;
+  state->lanes[3] = seed - XXH64_PRIME1;
+  state->buffered = 0;
+}
+
+// Consumes whole 32 byte stripes and returns the number of bytes read.
+static inline size_t xxh64_stripes(uint64_t* lanes,
+                                   const uint8_t* data,
+                                   size_t size) {
+  uint64_t v1 = lanes[0], v2 = lanes[1], v3 = lanes[2], v4 = lanes[3];
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    v1 = xxh64_round(v1, hash_read64(data + i));
+    v2 = xxh64_round(v2, hash_read64(data + i + 8));
+    v3 = xxh64_round(v3, hash_read64(data + i + 16));
+    v4 = xxh64_round(v4, hash_read64(data + i + 24));
+  }
+  lanes[0] = v1, lanes[1] = v2, lanes[2] = v3, lanes[3] = v4;
+  return i;
+}
+
+static inline void xxh64_update(xxh64_state* state,
+                                const uint8_t* data,
+                                size_t size) {
+  state->total += size;
+
+  if (state->buffered > 0) {
+    const size_t n = size < 32 - state->buffered ? size : 32 - state->buffered;
+    memcpy(state->buffer + state->buffered, data, n);
+    state->buffered += n;
+    data += n;
+    size -= n;
+    if (state->buffered < 32) {
+      return;
+    }
+    xxh64_stripes(state->lanes, state->buffer, 32);
+    state->buffered = 0;
+  }
+
+  const size_t n = xxh64_stripes(state->lanes, data, size);
+  memcpy(state->buffer, data + n, size - n);
+  state->buffered = size - n;
+}
+
+// Doesn't change |state|, more data can be added afterwards.
+static inline uint64_t xxh64_digest(const xxh64_state* state) {
+  uint64_t hash;
+  if (state->total >= 32) {
+    const uint64_t* v = state->lanes;
+    hash = xxh64_rotl(v[0], 1) + xxh64_rotl(v[1], 7) +
+           xxh64_rotl(v[2], 12) + xxh64_rotl(v[3], 18);
+    hash = xxh64_merge(hash, v[0]);
+    hash = xxh64_merge(hash, v[1]);
+    hash = xxh64_merge(hash, v[2]);
+    hash = xxh64_merge(hash, v[3]);
+  } else {
+    hash = state->seed + XXH64_PRIME5;
+  }
+  hash += state->total;
+
+  const uint8_t* p = state->buffer;
+  const uint8_t* end = p + state->buffered;
+  for (; p + 8 <= end; p += 8) {
+    hash ^= xxh64_round(0, hash_read64(p));
+    hash = xxh64_rotl(hash, 27) * XXH64_PRIME1 + XXH64_PRIME4;
+  }
+  if (p + 4 <= end) {
+    hash ^= hash_read32(p) * XXH64_PRIME1;
+    hash = xxh64_rotl(hash, 23) * XXH64_PRIME2 + XXH64_PRIME3;
+    p += 4;
+  }
+  for (; p < end; ++p) {
+    hash ^= *p * XXH64_PRIME5;
+    hash = xxh64_rotl(hash, 11) * XXH64_PRIME1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= XXH64_PRIME2;
+  hash ^= hash >> 29;
+  hash *= XXH64_PRIME3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+static inline uint64_t xxh64(const uint8_t* data, size_t size, uint64_t seed) {
+  xxh64_state state;
+  xxh64_init(&state, seed);
+  xxh64_update(&state, data, size);
+  return xxh64_digest(&state);
+}
+
+#endif  // HASH_H
@@ -0,0 +1,245 @@
+/* Copyright (c) 2010, Ben Noordhuis <info@bnoordhuis.nl>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef HEX_H
+#define HEX_H
+
+#include "CpuFeatures.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Hexadecimal encoding and decoding.
+//
+// hex_encode() writes 2 * size lowercase hex digits to |dst|.
+//
+// hex_decode() decodes |size| hex digits (upper or lower case) into
+// size / 2 bytes. |size| must be even. The SIMD kernels check a whole block
+// of digits at once and the scalar code accumulates the table lookups, so
+// there is no branch per byte. Returns false if the input contains a
+// character that is not a hex digit, in which case the contents of |dst|
+// are unspecified.
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static const signed char hex_values[256] = {
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+   0, 1, 2, 3, 4, 5, 6, 7, 8, 9,-1,-1,-1,-1,-1,-1,
+  -1,10,11,12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,10,11,12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+};
+
+// Portable fallbacks, also used for the tails that the SIMD loops leave.
+static inline void hex_encode_scalar(char* dst,
+                                     const uint8_t* src,
+                                     size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    dst[i * 2] = hex_digits[src[i] >> 4];
+    dst[i * 2 + 1] = hex_digits[src[i] & 15];
+  }
+}
+
+static inline bool hex_decode_scalar(uint8_t* dst,
+                                     const uint8_t* src,
+                                     size_t size) {
+  int invalid = 0;
+  for (size_t i = 0; i < size; i += 2) {
+    const int a = hex_values[src[i]];
+    const int b = hex_values[src[i + 1]];
+    invalid |= a | b;
+    dst[i / 2] = (uint8_t) (((a & 15) << 4) | (b & 15));
+  }
+  return invalid >= 0;
+}
+
+#if defined(BUFFERTOOLS_SSE2)
+// Maps 16 nibbles to '0'-'9' and 'a'-'f'.
+static inline __m128i hex_nibbles_sse2(__m128i n) {
+  const __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(n, _mm_set1_epi8(9)),
+                                        _mm_set1_epi8('a' - '0' - 10));
+  return _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')), letters);
+}
+
+// Maps 16 hex digits to their values. Clears bits in |valid| for bytes
+// that are not hex digits.
+static inline __m128i hex_values_sse2(__m128i c, __m128i* valid) {
+  // x <= limit as an unsigned comparison.
+  const __m128i d = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+  const __m128i is_digit =
+      _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+  const __m128i a = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)),
+                                 _mm_set1_epi8('a'));
+  const __m128i is_alpha =
+      _mm_cmpeq_epi8(_mm_min_epu8(a, _mm_set1_epi8(5)), a);
+  *valid = _mm_and_si128(*valid, _mm_or_si128(is_digit, is_alpha));
+  return _mm_or_si128(
+      _mm_and_si128(is_digit, d),
+      _mm_and_si128(is_alpha, _mm_add_epi8(a, _mm_set1_epi8(10))));
+}
+
+// Joins the high and low nibbles in each 16 bits lane into one byte.
+static inline __m128i hex_join_sse2(__m128i v) {
+  return _mm_or_si128(
+      _mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0xff)), 4),
+      _mm_srli_epi16(v, 8));
+}
+
+static void hex_encode_sse2(char* dst, const uint8_t* src, size_t size) {
+  const __m128i mask = _mm_set1_epi8(15);
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    const __m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+    const __m128i hi = hex_nibbles_sse2(
+        _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+    const __m128i lo = hex_nibbles_sse2(_mm_and_si128(v, mask));
+    _mm_storeu_si128((__m128i*) (dst + i * 2), _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i*) (dst + i * 2 + 16),
+                     _mm_unpackhi_epi8(hi, lo));
+  }
+  hex_encode_scalar(dst + i * 2, src + i, size - i);
+}
+
+static bool hex_decode_sse2(uint8_t* dst, const uint8_t* src, size_t size) {
+  __m128i valid = _mm_set1_epi8(-1);
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    const __m128i a = hex_values_sse2(
+        _mm_loadu_si128((const __m128i*) (src + i)), &valid);
+    const __m128i b = hex_values_sse2(
+        _mm_loadu_si128((const __m128i*) (src + i + 16)), &valid);
+    _mm_storeu_si128((__m128i*) (dst + i / 2),
+                     _mm_packus_epi16(hex_join_sse2(a), hex_join_sse2(b)));
+  }
+  if (_mm_movemask_epi8(valid) != 0xffff) {
+    return false;
+  }
+  return hex_decode_scalar(dst + i / 2, src + i, size - i);
+}
+#endif  // BUFFERTOOLS_SSE2
+
+#if defined(BUFFERTOOLS_X86)
+BUFFERTOOLS_TARGET("avx2")
+static inline __m256i hex_nibbles_avx2(__m256i n) {
+  const __m256i letters =
+      _mm256_and_si256(_mm256_cmpgt_epi8(n, _mm256_set1_epi8(9)),
+                       _mm256_set1_epi8('a' - '0' - 10));
+  return _mm256_add_epi8(_mm256_add_epi8(n, _mm256_set1_epi8('0')), letters);
+}
+
+BUFFERTOOLS_TARGET("avx2")
+static inline __m256i hex_values_avx2(__m256i c, __m256i* valid) {
+  const __m256i d = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+  const __m256i is_digit =
+      _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+  const __m256i a =
+      _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)),
+                      _mm256_set1_epi8('a'));
+  const __m256i is_alpha =
+      _mm256_cmpeq_epi8(_mm256_min_epu8(a, _mm256_set1_epi8(5)), a);
+  *valid = _mm256_and_si256(*valid, _mm256_or_si256(is_digit, is_alpha));
+  return _mm256_or_si256(
+      _mm256_and_si256(is_digit, d),
+      _mm256_and_si256(is_alpha, _mm256_add_epi8(a, _mm256_set1_epi8(10))));
+}
+
+BUFFERTOOLS_TARGET("avx2")
+static inline __m256i hex_join_avx2(__m256i v) {
+  return _mm256_or_si256(
+      _mm256_slli_epi16(_mm256_and_si256(v, _mm256_set1_epi16(0xff)), 4),
+      _mm256_srli_epi16(v, 8));
+}
+
+BUFFERTOOLS_TARGET("avx2")
+static void hex_encode_avx2(char* dst, const uint8_t* src, size_t size) {
+  const __m256i mask = _mm256_set1_epi8(15);
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    const __m256i v = _mm256_loadu_si256((const __m256i*) (src + i));
+    const __m256i hi = hex_nibbles_avx2(
+        _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+    const __m256i lo = hex_nibbles_avx2(_mm256_and_si256(v, mask));
+    // The unpacks work per 128 bits lane, put the halves back in order.
+    const __m256i a = _mm256_unpacklo_epi8(hi, lo);
+    const __m256i b = _mm256_unpackhi_epi8(hi, lo);
+    _mm256_storeu_si256((__m256i*) (dst + i * 2),
+                        _mm256_permute2x128_si256(a, b, 0x20));
+    _mm256_storeu_si256((__m256i*) (dst + i * 2 + 32),
+                        _mm256_permute2x128_si256(a, b, 0x31));
+  }
+  hex_encode_scalar(dst + i * 2, src + i, size - i);
+}
+
+BUFFERTOOLS_TARGET("avx2")
+static bool hex_decode_avx2(uint8_t* dst, const uint8_t* src, size_t size) {
+  __m256i valid = _mm256_set1_epi8(-1);
+  size_t i = 0;
+  for (; i + 64 <= size; i += 64) {
+    const __m256i a = hex_values_avx2(
+        _mm256_loadu_si256((const __m256i*) (src + i)), &valid);
+    const __m256i b = hex_values_avx2(
+        _mm256_loadu_si256((const __m256i*) (src + i + 32)), &valid);
+    // Same lane problem as above, the pack interleaves a and b.
+    const __m256i packed =
+        _mm256_packus_epi16(hex_join_avx2(a), hex_join_avx2(b));
+    _mm256_storeu_si256((__m256i*) (dst + i / 2),
+                        _mm256_permute4x64_epi64(packed, 0xd8));
+  }
+  if (_mm256_movemask_epi8(valid) != -1) {
+    return false;
+  }
+  return hex_decode_scalar(dst + i / 2, src + i, size - i);
+}
+#endif  // BUFFERTOOLS_X86
+
+static inline void hex_encode(char* dst, const uint8_t* src, size_t size) {
+#if defined(BUFFERTOOLS_X86)
+  if (cpu_has(CPU_AVX2)) {
+    hex_encode_avx2(dst, src, size);
+    return;
+  }
+#endif
+#if defined(BUFFERTOOLS_SSE2)
+  hex_encode_sse2(dst, src, size);
+#else
+  hex_encode_scalar(dst, src, size);
+#endif
+}
+
+static inline bool hex_decode(uint8_t* dst, const uint8_t* src, size_t size) {
+#if defined(BUFFERTOOLS_X86)
+  if (cpu_has(CPU_AVX2)) {
+    return hex_decode_avx2(dst, src, size);
+  }
+#endif
+#if defined(BUFFERTOOLS_SSE2)
+  return hex_decode_sse2(dst, src, size);
+#else
+  return hex_decode_scalar(dst, src, size);
+#endif
+}
+
+#endif  // HEX_H
@@ -0,0 +1,166 @@
+/* Copyright (c) 2010, Ben Noordhuis <info@bnoordhuis.nl>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if !defined(_WIN32)
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+// Maps a range of a file into memory so that it can be searched, compared
+// and hashed in the page cache, without reading it into the heap first.
+//
+// The mapping is read-only, so it shares the page cache and takes up no
+// memory or swap of its own. Writing to it faults, buffertools.cc refuses
+// to. mapped_file_release() swaps the file pages for anonymous zero pages at
+// the same address. That drops the file and its page cache right away while
+// the memory stays readable, so a thread pool job that's still scanning it
+// can't fault. The zero pages are writable, for node versions that can't
+// detach the buffer and its slices. The address range itself goes away in
+// mapped_file_unmap().
+//
+// Not implemented on Windows, mapped_file_map() fails with ENOSYS there.
+enum mapped_file_advice {
+  MAPPED_FILE_NORMAL,
+  MAPPED_FILE_SEQUENTIAL,
+  MAPPED_FILE_RANDOM
+};
+
+struct mapped_file {
+  void* base;     // page aligned start of the mapping
+  size_t size;    // bytes mapped from |base|
+  uint8_t* data;  // the byte at the requested offset
+  size_t length;
+};
+
+// Maps |length| bytes from |offset| onwards, fewer if the file ends before
+// that. An offset past the end of the file maps nothing. Returns zero or
+// an errno, with the name of the call that failed in |*syscall|.
+static inline int mapped_file_map(mapped_file* file,
+                                  const char* path,
+                                  uint64_t offset,
+                                  uint64_t length,
+                                  mapped_file_advice advice,
+                                  bool will_need,
+                                  const char** syscall) {
+  file->base = NULL;
+  file->size = 0;
+  file->data = NULL;
+  file->length = 0;
+
+#if defined(_WIN32)
+  *syscall = "mmap";
+  return ENOSYS;
+#else
+  const int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    *syscall = "open";
+    return errno;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    const int err = errno;
+    close(fd);
+    *syscall = "fstat";
+    return err;
+  }
+
+  const uint64_t file_size = (uint64_t) st.st_size;
+  if (offset > file_size) {
+    offset = file_size;
+  }
+  if (length > file_size - offset) {
+    length = file_size - offset;
+  }
+  if (length == 0) {
+    close(fd);
+    return 0;
+  }
+
+  // mmap() wants an offset that is a multiple of the page size.
+  const uint64_t page_size = (uint64_t) sysconf(_SC_PAGESIZE);
+  const uint64_t delta = offset % page_size;
+  if (length + delta > (size_t) -1) {
+    close(fd);
+    *syscall = "mmap";
+    return EFBIG;
+  }
+
+  const size_t size = (size_t) (length + delta);
+  void* base = mmap(NULL,
+                    size,
+                    PROT_READ,
+                    MAP_PRIVATE,
+                    fd,
+                    (off_t) (offset - delta));
+  const int err = errno;
+  close(fd);  // The mapping keeps its own reference to the file.
+  if (base == MAP_FAILED) {
+    *syscall = "mmap";
+    return err;
+  }
+
+  // Only hints, the mapping works without them.
+  if (advice == MAPPED_FILE_SEQUENTIAL) {
+    madvise(base, size, MADV_SEQUENTIAL);
+  } else if (advice == MAPPED_FILE_RANDOM) {
+    madvise(base, size, MADV_RANDOM);
+  }
+  if (will_need) {
+    madvise(base, size, MADV_WILLNEED);
+  }
+
+  file->base = base;
+  file->size = size;
+  file->data = (uint8_t*) base + delta;
+  file->length = (size_t) length;
+  return 0;
+#endif
+}
+
+// Lets go of the file. The memory reads as zeroes afterwards.
+static inline void mapped_file_release(mapped_file* file) {
+#if !defined(_WIN32)
+  if (file->size > 0) {
+    mmap(file->base,
+         file->size,
+         PROT_READ | PROT_WRITE,
+         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE,
+         -1,
+         0);
+  }
+#endif
+}
+
+static inline void mapped_file_unmap(mapped_file* file) {
+#if !defined(_WIN32)
+  if (file->size > 0) {
+    munmap(file->base, file->size);
+  }
+#endif
+  file->base = NULL;
+  file->size = 0;
+}
+
+#endif  // MAPPED_FILE_H
@@ -0,0 +1,657 @@
+/* Copyright (c) 2010, Ben Noordhuis <info@bnoordhuis.nl>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include "CpuFeatures.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Questions about the bytes in a buffer that are answered in one pass:
+//
+//  - count_byte() counts the occurrences of a byte. The SIMD versions add
+//    the compare masks up in 8 bit lanes and fold those into 64 bit sums
+//    with psadbw before they can overflow, every 255 blocks.
+//  - byte_histogram() counts all 256 byte values. It spreads the counts
+//    over four tables so that runs of the same byte don't stall on the
+//    increment of one counter.
+//  - is_ascii() and is_utf8() validate. UTF-8 is checked 32 bytes at a time
+//    with the lookup algorithm of Keiser and Lemire, "Validating UTF-8 In
+//    Less Than One Instruction Per Byte" (2021): three pshufb lookups on
+//    the nibbles of each byte and the byte before it flag every invalid
+//    two byte sequence, what is left are the continuation bytes that a
+//    three or four byte lead expects further back.
+//  - find_first_of() and find_first_not_of() look for the first byte that
+//    is or isn't in a set of bytes. The set is a 256 bit bitmap that
+//    pshufb looks up 32 bytes at a time: the low nibble of a byte selects
+//    a row of eight bits, the high nibble a bit in it.
+//
+// The lookups need pshufb: without AVX2, is_utf8() and the set scans run the
+// same algorithms 16 bytes at a time with SSSE3. CPUs without SSSE3 get an
+// SSE2 check for runs of ASCII and scalar code for the rest.
+
+//
+// count
+//
+static inline size_t count_byte_scalar(const uint8_t* data,
+                                       size_t size,
+                                       uint8_t c) {
+  size_t n = 0;
+  for (size_t i = 0; i < size; ++i) {
+    n += data[i] == c;
+  }
+  return n;
+}
+
+#if defined(BUFFERTOOLS_SSE2)
+static size_t count_byte_sse2(const uint8_t* data, size_t size, uint8_t c) {
+  const __m128i needle = _mm_set1_epi8((char) c);
+  const __m128i zero = _mm_setzero_si128();
+  size_t n = 0;
+  size_t i = 0;
+  while (i + 16 <= size) {
+    __m128i acc = zero;
+    for (int k = 0; k < 255 && i + 16 <= size; ++k, i += 16) {
+      const __m128i x = _mm_loadu_si128((const __m128i*) (data + i));
+      acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(x, needle));
+    }
+    const __m128i sums = _mm_sad_epu8(acc, zero);
+    n += _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
+  }
+  return n + count_byte_scalar(data + i, size - i, c);
+}
+#endif  // BUFFERTOOLS_SSE2
+
+#if defined(BUFFERTOOLS_X86)
+BUFFERTOOLS_TARGET("avx2")
+static size_t count_byte_avx2(const uint8_t* data, size_t size, uint8_t c) {
+  const __m256i needle = _mm256_set1_epi8((char) c);
+  const __m256i zero = _mm256_setzero_si256();
+  size_t n = 0;
+  size_t i = 0;
+  while (i + 32 <= size) {
+    __m256i acc = zero;
+    for (int k = 0; k < 255 && i + 32 <= size; ++k, i += 32) {
+      const __m256i x = _mm256_loadu_si256((const __m256i*) (data + i));
+      acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(x, needle));
+    }
+    uint64_t sums[4];
+    _mm256_storeu_si256((__m256i*) sums, _mm256_sad_epu8(acc, zero));
+    n += sums[0] + sums[1] + sums[2] + sums[3];
+  }
+  return n + count_byte_scalar(data + i, size - i, c);
+}
+#endif  // BUFFERTOOLS_X86
+
+static inline size_t count_byte(const uint8_t* data, size_t size, uint8_t c) {
+#if defined(BUFFERTOOLS_X86)
+  if (cpu_has(CPU_AVX2)) {
+    return count_byte_avx2(data, size, c);
+  }
+#endif
+#if defined(BUFFERTOOLS_SSE2)
+  return count_byte_sse2(data, size, c);
+#else
+  return count_byte_scalar(data, size, c);
+#endif
+}
+
+//
+// histogram
+//
+// Adds the number of times that every byte value occurs to |counts|.
+static inline void byte_histogram(const uint8_t* data,
+                                  size_t size,
+                                  uint32_t counts[256]) {
+  uint32_t tables[4][256];
+  memset(tables, 0, sizeof(tables));
+
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t x;
+    memcpy(&x, data + i, 8);
+    tables[0][x & 0xff]++;
+    tables[1][(x >> 8) & 0xff]++;
+    tables[2][(x >> 16) & 0xff]++;
+    tables[3][(x >> 24) & 0xff]++;
+    tables[0][(x >> 32) & 0xff]++;
+    tables[1][(x >> 40) & 0xff]++;
+    tables[2][(x >> 48) & 0xff]++;
+    tables[3][x >> 56]++;
+  }
+  for (; i < size; ++i) {
+    tables[0][data[i]]++;
+  }
+
+  for (int c = 0; c < 256; ++c) {
+    counts[c] += tables[0][c] + tables[1][c] + tables[2][c] + tables[3][c];
+  }
+}
+
+//
+// validation
+//
+static inline bool is_ascii_scalar(const uint8_t* data, size_t size) {
+  uint64_t acc = 0;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t x;
+    memcpy(&x, data + i, 8);
+    acc |= x;
+  }
+  for (; i < size; ++i) {
+    acc |= data[i];
+  }
+  return (acc & 0x8080808080808080ULL) == 0;
+}
+
+// Returns the number of bytes that a valid sequence starting at |data|
+// takes up, or 0 if it isn't valid.
+static inline size_t utf8_sequence_length(const uint8_t* data, size_t size) {
+  const uint8_t c = data[0];
+  if (c < 0x80) {
+    return 1;
+  }
+
+  size_t n;
+  uint8_t lo = 0x80, hi = 0xbf;  // the range of the second byte
+  if (c < 0xc2) {
+    return 0;  // continuation byte or overlong two byte sequence
+  } else if (c < 0xe0) {
+    n = 2;
+  } else if (c < 0xf0) {
+    n = 3;
+    if (c == 0xe0) lo = 0xa0;  // overlong
+    if (c == 0xed) hi = 0x9f;  // surrogate
+  } else if (c < 0xf5) {
+    n = 4;
+    if (c == 0xf0) lo = 0x90;  // overlong
+    if (c == 0xf4) hi = 0x8f;  // past U+10FFFF
+  } else {
+    return 0;
+  }
+
+  if (size < n || data[1] < lo || data[1] > hi) {
+    return 0;
+  }
+  for (size_t i = 2; i < n; ++i) {
+    if ((data[i] & 0xc0) != 0x80) {
+      return 0;
+    }
+  }
+  return n;
+}
+
+static inline bool is_utf8_scalar(const uint8_t* data, size_t size) {
+  size_t i = 0;
+  while (i < size) {
+    const size_t n = utf8_sequence_length(data + i, size - i);
+    if (n == 0) {
+      return false;
+    }
+    i += n;
+  }
+  return true;
+}
+
+#if defined(BUFFERTOOLS_SSE2)
+static bool is_ascii_sse2(const uint8_t* data, size_t size) {
+  size_t i = 0;
+  for (; i + 64 <= size; i += 64) {
+    const __m128i x0 = _mm_loadu_si128((const __m128i*) (data + i));
+    const __m128i x1 = _mm_loadu_si128((const __m128i*) (data + i + 16));
+    const __m128i x2 = _mm_loadu_si128((const __m128i*) (data + i + 32));
+    const __m128i x3 = _mm_loadu_si128((const __m128i*) (data + i + 48));
+    const __m128i x = _mm_or_si128(_mm_or_si128(x0, x1), _mm_or_si128(x2, x3));
+    if (_mm_movemask_epi8(x) != 0) {
+      return false;
+    }
+  }
+  return is_ascii_scalar(data + i, size - i);
+}
+
+// Skips ahead 16 bytes at a time while the data is ASCII, then validates
+// the rest one sequence at a time until it's back at ASCII.
+static bool is_utf8_sse2(const uint8_t* data, size_t size) {
+  size_t i = 0;
+  while (i < size) {
+    if (i + 16 <= size) {
+      const __m128i x = _mm_loadu_si128((const __m128i*) (data + i));
+      if (_mm_movemask_epi8(x) == 0) {
+        i += 16;
+        continue;
+      }
+    }
+    const size_t n = utf8_sequence_length(data + i, size - i);
+    if (n == 0) {
+      return false;
+    }
+    i += n;
+  }
+  return true;
+}
+#endif  // BUFFERTOOLS_SSE2
+
+#if defined(BUFFERTOOLS_X86)
+BUFFERTOOLS_TARGET("avx2")
+static bool is_ascii_avx2(const uint8_t* data, size_t size) {
+  size_t i = 0;
+  for (; i + 128 <= size; i += 128) {
+    const __m256i x0 = _mm256_loadu_si256((const __m256i*) (data + i));
+    const __m256i x1 = _mm256_loadu_si256((const __m256i*) (data + i + 32));
+    const __m256i x2 = _mm256_loadu_si256((const __m256i*) (data + i + 64));
+    const __m256i x3 = _mm256_loadu_si256((const __m256i*) (data + i + 96));
+    const __m256i x =
+        _mm256_or_si256(_mm256_or_si256(x0, x1), _mm256_or_si256(x2, x3));
+    if (_mm256_movemask_epi8(x) != 0) {
+      return false;
+    }
+  }
+  return is_ascii_scalar(data + i, size - i);
+}
+
+// The 32 bytes that end |n| bytes before the end of |x|, with the bytes
+// from |prev| in front.
+#define UTF8_PREV_AVX2(x, prev, n)                                            \
+  _mm256_alignr_epi8((x), _mm256_permute2x128_si256((prev), (x), 0x21), 16 - (n))
+
+// The error bits of the lookup tables. A pair of bytes is invalid if a bit
+// is set in all three lookups.
+#define UTF8_TOO_SHORT (1 << 0)      // 11______ 0_______, 11______ 11______
+#define UTF8_TOO_LONG (1 << 1)       // 0_______ 10______
+#define UTF8_OVERLONG_3 (1 << 2)     // 11100000 100_____
+#define UTF8_TOO_LARGE (1 << 3)      // 11110100 1001____ and up
+#define UTF8_SURROGATE (1 << 4)      // 11101101 101_____
+#define UTF8_OVERLONG_2 (1 << 5)     // 1100000_ 10______
+#define UTF8_TOO_LARGE_1000 (1 << 6) // 11110101 1000____ and up
+#define UTF8_OVERLONG_4 (1 << 6)     // 11110000 1000____
+#define UTF8_TWO_CONTS (1 << 7)      // 10______ 10______
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+// The three lookup tables, indexed by the high and the low nibble of the
+// first byte of a pair and by the high nibble of the second.
+#define UTF8_LARGE (UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000)
+#define UTF8_CONT (UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS)
+#define UTF8_BYTE_1_HIGH_TABLE                                                \
+  UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,                 \
+  UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,                 \
+  UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,             \
+  UTF8_TOO_SHORT | UTF8_OVERLONG_2,                                           \
+  UTF8_TOO_SHORT,                                                             \
+  UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,                          \
+  UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+#define UTF8_BYTE_1_LOW_TABLE                                                 \
+  UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,           \
+  UTF8_CARRY | UTF8_OVERLONG_2,                                               \
+  UTF8_CARRY, UTF8_CARRY,                                                     \
+  UTF8_CARRY | UTF8_TOO_LARGE,                                                \
+  UTF8_LARGE, UTF8_LARGE, UTF8_LARGE, UTF8_LARGE,                             \
+  UTF8_LARGE, UTF8_LARGE, UTF8_LARGE, UTF8_LARGE,                             \
+  UTF8_LARGE | UTF8_SURROGATE,                                                \
+  UTF8_LARGE, UTF8_LARGE
+#define UTF8_BYTE_2_HIGH_TABLE                                                \
+  UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,             \
+  UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,             \
+  UTF8_CONT | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,        \
+  UTF8_CONT | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,                               \
+  UTF8_CONT | UTF8_SURROGATE | UTF8_TOO_LARGE,                                \
+  UTF8_CONT | UTF8_SURROGATE | UTF8_TOO_LARGE,                                \
+  UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+
+BUFFERTOOLS_TARGET("avx2")
+static inline __m256i utf8_lookup_avx2(__m256i table, __m256i nibbles) {
+  return _mm256_shuffle_epi8(table, nibbles);
+}
+
+// Returns the error bits of the 32 bytes in |x|, |prev| is the block before.
+BUFFERTOOLS_TARGET("avx2")
+static inline __m256i utf8_check_block_avx2(__m256i x, __m256i prev) {
+  const __m256i byte_1_high_table =
+      _mm256_setr_epi8(UTF8_BYTE_1_HIGH_TABLE, UTF8_BYTE_1_HIGH_TABLE);
+  const __m256i byte_1_low_table =
+      _mm256_setr_epi8(UTF8_BYTE_1_LOW_TABLE, UTF8_BYTE_1_LOW_TABLE);
+  const __m256i byte_2_high_table =
+      _mm256_setr_epi8(UTF8_BYTE_2_HIGH_TABLE, UTF8_BYTE_2_HIGH_TABLE);
+  const __m256i low_nibble = _mm256_set1_epi8(0x0f);
+
+  const __m256i prev1 = UTF8_PREV_AVX2(x, prev, 1);
+  const __m256i prev1_high =
+      _mm256_and_si256(_mm256_srli_epi16(prev1, 4), low_nibble);
+  const __m256i prev1_low = _mm256_and_si256(prev1, low_nibble);
+  const __m256i x_high = _mm256_and_si256(_mm256_srli_epi16(x, 4), low_nibble);
+  const __m256i special = _mm256_and_si256(
+      _mm256_and_si256(utf8_lookup_avx2(byte_1_high_table, prev1_high),
+                       utf8_lookup_avx2(byte_1_low_table, prev1_low)),
+      utf8_lookup_avx2(byte_2_high_table, x_high));
+
+  // Bytes two after a 111_____ lead or three after a 1111____ lead have to
+  // be continuation bytes. The pair lookups flagged every continuation byte
+  // as TWO_CONTS, that cancels out exactly where one is expected.
+  const __m256i prev2 = UTF8_PREV_AVX2(x, prev, 2);
+  const __m256i prev3 = UTF8_PREV_AVX2(x, prev, 3);
+  const __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(0xe0 - 0x80));
+  const __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xf0 - 0x80));
+  const __m256i must_be_cont = _mm256_and_si256(_mm256_or_si256(third, fourth),
+                                                _mm256_set1_epi8((char) 0x80));
+  return _mm256_xor_si256(must_be_cont, special);
+}
+
+// Non-zero where the last bytes of |x| start a sequence that is cut short.
+BUFFERTOOLS_TARGET("avx2")
+static inline __m256i utf8_incomplete_avx2(__m256i x) {
+  const __m256i max = _mm256_setr_epi8(
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      (char) (0xf0 - 1), (char) (0xe0 - 1), (char) (0xc0 - 1));
+  return _mm256_subs_epu8(x, max);
+}
+
+BUFFERTOOLS_TARGET("avx2")
+static bool is_utf8_avx2(const uint8_t* data, size_t size) {
+  __m256i error = _mm256_setzero_si256();
+  __m256i prev = _mm256_setzero_si256();
+  __m256i incomplete = _mm256_setzero_si256();
+
+  size_t i = 0;
+  for (;;) {
+    __m256i x;
+    if (i + 32 <= size) {
+      x = _mm256_loadu_si256((const __m256i*) (data + i));
+    } else if (i < size) {
+      uint8_t tail[32] = { 0 };  // padded with ASCII
+      memcpy(tail, data + i, size - i);
+      x = _mm256_loadu_si256((const __m256i*) tail);
+    } else {
+      break;
+    }
+
+    if (_mm256_movemask_epi8(x) == 0) {
+      // An ASCII block, only a sequence cut short by it can be wrong.
+      error = _mm256_or_si256(error, incomplete);
+    } else {
+      error = _mm256_or_si256(error, utf8_check_block_avx2(x, prev));
+      incomplete = utf8_incomplete_avx2(x);
+    }
+    prev = x;
+    i += 32;
+
+    // Check every 1 KB, invalid data usually shows up early.
+    if ((i & 1023) == 0 && !_mm256_testz_si256(error, error)) {
+      return false;
+    }
+  }
+
+  error = _mm256_or_si256(error, incomplete);
+  return _mm256_testz_si256(error, error);
+}
+
+// The same, 16 bytes at a time.
+#define UTF8_PREV_SSSE3(x, prev, n) _mm_alignr_epi8((x), (prev), 16 - (n))
+
+BUFFERTOOLS_TARGET("ssse3")
+static inline __m128i utf8_check_block_ssse3(__m128i x, __m128i prev) {
+  const __m128i byte_1_high_table = _mm_setr_epi8(UTF8_BYTE_1_HIGH_TABLE);
+  const __m128i byte_1_low_table = _mm_setr_epi8(UTF8_BYTE_1_LOW_TABLE);
+  const __m128i byte_2_high_table = _mm_setr_epi8(UTF8_BYTE_2_HIGH_TABLE);
+  const __m128i low_nibble = _mm_set1_epi8(0x0f);
+
+  const __m128i prev1 = UTF8_PREV_SSSE3(x, prev, 1);
+  const __m128i prev1_high =
+      _mm_and_si128(_mm_srli_epi16(prev1, 4), low_nibble);
+  const __m128i prev1_low = _mm_and_si128(prev1, low_nibble);
+  const __m128i x_high = _mm_and_si128(_mm_srli_epi16(x, 4), low_nibble);
+  const __m128i special = _mm_and_si128(
+      _mm_and_si128(_mm_shuffle_epi8(byte_1_high_table, prev1_high),
+                    _mm_shuffle_epi8(byte_1_low_table, prev1_low)),
+      _mm_shuffle_epi8(byte_2_high_table, x_high));
+
+  const __m128i prev2 = UTF8_PREV_SSSE3(x, prev, 2);
+  const __m128i prev3 = UTF8_PREV_SSSE3(x, prev, 3);
+  const __m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8(0xe0 - 0x80));
+  const __m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8(0xf0 - 0x80));
+  const __m128i must_be_cont = _mm_and_si128(_mm_or_si128(third, fourth),
+                                             _mm_set1_epi8((char) 0x80));
+  return _mm_xor_si128(must_be_cont, special);
+}
+
+BUFFERTOOLS_TARGET("ssse3")
+static inline __m128i utf8_incomplete_ssse3(__m128i x) {
+  const __m128i max = _mm_setr_epi8(
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      (char) (0xf0 - 1), (char) (0xe0 - 1), (char) (0xc0 - 1));
+  return _mm_subs_epu8(x, max);
+}
+
+BUFFERTOOLS_TARGET("ssse3")
+static inline bool utf8_ok_ssse3(__m128i error) {
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) ==
+         0xffff;
+}
+
+BUFFERTOOLS_TARGET("ssse3")
+static bool is_utf8_ssse3(const uint8_t* data, size_t size) {
+  __m128i error = _mm_setzero_si128();
+  __m128i prev = _mm_setzero_si128();
+  __m128i incomplete = _mm_setzero_si128();
+
+  size_t i = 0;
+  for (;;) {
+    __m128i x;
+    if (i + 16 <= size) {
+      x = _mm_loadu_si128((const __m128i*) (data + i));
+    } else if (i < size) {
+      uint8_t tail[16] = { 0 };  // padded with ASCII
+      memcpy(tail, data + i, size - i);
+      x = _mm_loadu_si128((const __m128i*) tail);
+    } else {
+      break;
+    }
+
+    if (_mm_movemask_epi8(x) == 0) {
+      error = _mm_or_si128(error, incomplete);
+    } else {
+      error = _mm_or_si128(error, utf8_check_block_ssse3(x, prev));
+      incomplete = utf8_incomplete_ssse3(x);
+    }
+    prev = x;
+    i += 16;
+
+    if ((i & 1023) == 0 && !utf8_ok_ssse3(error)) {
+      return false;
+    }
+  }
+
+  return utf8_ok_ssse3(_mm_or_si128(error, incomplete));
+}
+
+#undef UTF8_PREV_AVX2
+#undef UTF8_PREV_SSSE3
+#undef UTF8_LARGE
+#undef UTF8_CONT
+#undef UTF8_BYTE_1_HIGH_TABLE
+#undef UTF8_BYTE_1_LOW_TABLE
+#undef UTF8_BYTE_2_HIGH_TABLE
+#undef UTF8_TOO_SHORT
+#undef UTF8_TOO_LONG
+#undef UTF8_OVERLONG_3
+#undef UTF8_TOO_LARGE
+#undef UTF8_SURROGATE
+#undef UTF8_OVERLONG_2
+#undef UTF8_TOO_LARGE_1000
+#undef UTF8_OVERLONG_4
+#undef UTF8_TWO_CONTS
+#undef UTF8_CARRY
+#endif  // BUFFERTOOLS_X86
+
+static inline bool is_ascii(const uint8_t* data, size_t size) {
+#if defined(BUFFERTOOLS_X86)
+  if (cpu_has(CPU_AVX2)) {
+    return is_ascii_avx2(data, size);
+  }
+#endif
+#if defined(BUFFERTOOLS_SSE2)
+  return is_ascii_sse2(data, size);
+#else
+  return is_ascii_scalar(data, size);
+#endif
+}
+
+static inline bool is_utf8(const uint8_t* data, size_t size) {
+#if defined(BUFFERTOOLS_X86)
+  if (cpu_has(CPU_AVX2)) {
+    return is_utf8_avx2(data, size);
+  }
+  if (cpu_has(CPU_SSSE3)) {
+    return is_utf8_ssse3(data, size);
+  }
+#endif
+#if defined(BUFFERTOOLS_SSE2)
+  return is_utf8_sse2(data, size);
+#else
+  return is_utf8_scalar(data, size);
+#endif
+}
+
+//
+// byte sets
+//
+// Bit |c >> 4| of rows[c & 15] is set if byte |c| is in the set, split
+// over two tables for high nibbles 0-7 and 8-15, the way pshufb likes it.
+struct byte_set {
+  uint8_t low[16];   // bytes 0x00 - 0x7f
+  uint8_t high[16];  // bytes 0x80 - 0xff
+};
+
+static inline void byte_set_init(byte_set* set,
+                                 const uint8_t* bytes,
+                                 size_t size) {
+  memset(set, 0, sizeof(*set));
+  for (size_t i = 0; i < size; ++i) {
+    const uint8_t c = bytes[i];
+    uint8_t* rows = c < 0x80 ? set->low : set->high;
+    rows[c & 15] |= (uint8_t) (1 << ((c >> 4) & 7));
+  }
+}
+
+static inline bool byte_set_has(const byte_set* set, uint8_t c) {
+  const uint8_t* rows = c < 0x80 ? set->low : set->high;
+  return (rows[c & 15] >> ((c >> 4) & 7)) & 1;
+}
+
+// Returns the index of the first byte that is (or with |negate|, isn't)
+// in the set, or |size| if there is none.
+static inline size_t find_first_of_scalar(const uint8_t* data,
+                                          size_t size,
+                                          const byte_set* set,
+                                          bool negate) {
+  size_t i = 0;
+  for (; i < size; ++i) {
+    if (byte_set_has(set, data[i]) != negate) {
+      break;
+    }
+  }
+  return i;
+}
+
+#if defined(BUFFERTOOLS_X86)
+BUFFERTOOLS_TARGET("avx2")
+static size_t find_first_of_avx2(const uint8_t* data,
+                                 size_t size,
+                                 const byte_set* set,
+                                 bool negate) {
+  const __m128i low128 = _mm_loadu_si128((const __m128i*) set->low);
+  const __m128i high128 = _mm_loadu_si128((const __m128i*) set->high);
+  const __m256i low = _mm256_inserti128_si256(
+      _mm256_castsi128_si256(low128), low128, 1);
+  const __m256i high = _mm256_inserti128_si256(
+      _mm256_castsi128_si256(high128), high128, 1);
+  const __m256i bits = _mm256_setr_epi8(
+      1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+      1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+  const __m256i low_nibble = _mm256_set1_epi8(0x0f);
+  const __m256i sign = _mm256_set1_epi8((char) 0x80);
+  const unsigned flip = negate ? 0xffffffff : 0;
+
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    const __m256i x = _mm256_loadu_si256((const __m256i*) (data + i));
+    // pshufb returns zero for indexes with the top bit set, so each table
+    // only answers for its own half of the byte values.
+    const __m256i rows = _mm256_or_si256(
+        _mm256_shuffle_epi8(low, x),
+        _mm256_shuffle_epi8(high, _mm256_xor_si256(x, sign)));
+    const __m256i bit = _mm256_shuffle_epi8(
+        bits,
+        _mm256_and_si256(_mm256_srli_epi16(x, 4), low_nibble));
+    const __m256i hit = _mm256_cmpeq_epi8(_mm256_and_si256(rows, bit), bit);
+    const unsigned mask = (unsigned) _mm256_movemask_epi8(hit) ^ flip;
+    if (mask != 0) {
+      return i + BUFFERTOOLS_CTZ(mask);
+    }
+  }
+  return i + find_first_of_scalar(data + i, size - i, set, negate);
+}
+
+BUFFERTOOLS_TARGET("ssse3")
+static size_t find_first_of_ssse3(const uint8_t* data,
+                                  size_t size,
+                                  const byte_set* set,
+                                  bool negate) {
+  const __m128i low = _mm_loadu_si128((const __m128i*) set->low);
+  const __m128i high = _mm_loadu_si128((const __m128i*) set->high);
+  const __m128i bits = _mm_setr_epi8(
+      1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+  const __m128i low_nibble = _mm_set1_epi8(0x0f);
+  const __m128i sign = _mm_set1_epi8((char) 0x80);
+  const unsigned flip = negate ? 0xffff : 0;
+
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    const __m128i x = _mm_loadu_si128((const __m128i*) (data + i));
+    const __m128i rows = _mm_or_si128(
+        _mm_shuffle_epi8(low, x),
+        _mm_shuffle_epi8(high, _mm_xor_si128(x, sign)));
+    const __m128i bit = _mm_shuffle_epi8(
+        bits,
+        _mm_and_si128(_mm_srli_epi16(x, 4), low_nibble));
+    const __m128i hit = _mm_cmpeq_epi8(_mm_and_si128(rows, bit), bit);
+    const unsigned mask = (unsigned) _mm_movemask_epi8(hit) ^ flip;
+    if (mask != 0) {
+      return i + BUFFERTOOLS_CTZ(mask);
+    }
+  }
+  return i + find_first_of_scalar(data + i, size - i, set, negate);
+}
+#endif  // BUFFERTOOLS_X86
+
+static inline size_t find_first_of(const uint8_t* data,
+                                   size_t size,
+                                   const byte_set* set,
+                                   bool negate) {
+#if defined(BUFFERTOOLS_X86)
+  if (cpu_has(CPU_AVX2)) {
+    return find_first_of_avx2(data, size, set, negate);
+  }
+  if (cpu_has(CPU_SSSE3)) {
+    return find_first_of_ssse3(data, size, set, negate);
+  }
+#endif
+  return find_first_of_scalar(data, size, set, negate);
+}
+
+#endif  // SCAN_H
@@ -0,0 +1,363 @@
+/* Copyright (c) 2010, Ben Noordhuis <info@bnoordhuis.nl>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "BoyerMoore.h"
+#include "CpuFeatures.h"
+#include "Stats.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Substring search that picks the algorithm by needle length:
+//
+//  - single bytes go to memchr() or its reverse counterpart,
+//  - short needles go through a SIMD filter that compares the first and
+//    the last byte of the needle against 16 or 32 haystack positions at
+//    a time and only then calls memcmp(),
+//  - long needles use Boyer-Moore, where the table setup pays for itself.
+//
+// Functions that end in _last search right-to-left and return the last
+// occurrence. All of them return NULL when there is no match.
+#define SEARCH_SHORT_NEEDLE 32
+
+static inline const uint8_t* search_byte(const uint8_t* haystack,
+                                         size_t size,
+                                         uint8_t c) {
+  return (const uint8_t*) memchr(haystack, c, size);
+}
+
+static inline const uint8_t* search_byte_last(const uint8_t* haystack,
+                                              size_t size,
+                                              uint8_t c) {
+#if defined(BUFFERTOOLS_SSE2)
+  const __m128i v = _mm_set1_epi8(c);
+  while (size >= 16) {
+    size -= 16;
+    const __m128i block =
+        _mm_loadu_si128((const __m128i*) (haystack + size));
+    const unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, v));
+    if (mask) {
+      return haystack + size + 31 - BUFFERTOOLS_CLZ(mask);
+    }
+  }
+#endif
+  while (size > 0) {
+    if (haystack[--size] == c) {
+      return haystack + size;
+    }
+  }
+  return NULL;
+}
+
+// Portable fallbacks, also used for the tails that the SIMD loops leave.
+static inline const uint8_t* search_short_scalar(const uint8_t* haystack,
+                                                 size_t size,
+                                                 const uint8_t* needle,
+                                                 size_t needle_size) {
+  if (needle_size > size) {
+    return NULL;
+  }
+
+  const uint8_t* p = haystack;
+  const uint8_t* end = haystack + size - needle_size + 1;
+  while ((p = (const uint8_t*) memchr(p, needle[0], end - p))) {
+    if (memcmp(p + 1, needle + 1, needle_size - 1) == 0) {
+      return p;
+    }
+    ++p;
+  }
+  return NULL;
+}
+
+static inline const uint8_t* search_short_last_scalar(const uint8_t* haystack,
+                                                      size_t size,
+                                                      const uint8_t* needle,
+                                                      size_t needle_size) {
+  if (needle_size > size) {
+    return NULL;
+  }
+
+  for (size_t i = size - needle_size + 1; i-- > 0;) {
+    if (haystack[i] == needle[0] &&
+        memcmp(haystack + i + 1, needle + 1, needle_size - 1) == 0) {
+      return haystack + i;
+    }
+  }
+  return NULL;
+}
+
+#if defined(BUFFERTOOLS_SSE2)
+static const uint8_t* search_short_sse2(const uint8_t* haystack,
+                                        size_t size,
+                                        const uint8_t* needle,
+                                        size_t needle_size) {
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last = _mm_set1_epi8(needle[needle_size - 1]);
+
+  size_t i = 0;
+  for (; i + needle_size + 15 <= size; i += 16) {
+    const __m128i block_first =
+        _mm_loadu_si128((const __m128i*) (haystack + i));
+    const __m128i block_last =
+        _mm_loadu_si128((const __m128i*) (haystack + i + needle_size - 1));
+    unsigned mask = _mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+                      _mm_cmpeq_epi8(block_last, last)));
+    while (mask) {
+      const unsigned bit = BUFFERTOOLS_CTZ(mask);
+      if (memcmp(haystack + i + bit + 1, needle + 1, needle_size - 2) == 0) {
+        return haystack + i + bit;
+      }
+      mask &= mask - 1;
+    }
+  }
+
+  return search_short_scalar(haystack + i, size - i, needle, needle_size);
+}
+
+static const uint8_t* search_short_last_sse2(const uint8_t* haystack,
+                                             size_t size,
+                                             const uint8_t* needle,
+                                             size_t needle_size) {
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last = _mm_set1_epi8(needle[needle_size - 1]);
+
+  // Candidate start positions are [0, i), processed back to front.
+  size_t i = size - needle_size + 1;
+  while (i >= 16) {
+    i -= 16;
+    const __m128i block_first =
+        _mm_loadu_si128((const __m128i*) (haystack + i));
+    const __m128i block_last =
+        _mm_loadu_si128((const __m128i*) (haystack + i + needle_size - 1));
+    unsigned mask = _mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+                      _mm_cmpeq_epi8(block_last, last)));
+    while (mask) {
+      const unsigned bit = 31 - BUFFERTOOLS_CLZ(mask);
+      if (memcmp(haystack + i + bit + 1, needle + 1, needle_size - 2) == 0) {
+        return haystack + i + bit;
+      }
+      mask &= ~(1u << bit);
+    }
+  }
+
+  return search_short_last_scalar(haystack,
+                                  i + needle_size - 1,
+                                  needle,
+                                  needle_size);
+}
+#endif  // BUFFERTOOLS_SSE2
+
+#if defined(BUFFERTOOLS_X86)
+BUFFERTOOLS_TARGET("avx2")
+static const uint8_t* search_short_avx2(const uint8_t* haystack,
+                                        size_t size,
+                                        const uint8_t* needle,
+                                        size_t needle_size) {
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[needle_size - 1]);
+
+  size_t i = 0;
+  for (; i + needle_size + 31 <= size; i += 32) {
+    const __m256i block_first =
+        _mm256_loadu_si256((const __m256i*) (haystack + i));
+    const __m256i block_last =
+        _mm256_loadu_si256((const __m256i*) (haystack + i + needle_size - 1));
+    unsigned mask = _mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+                         _mm256_cmpeq_epi8(block_last, last)));
+    while (mask) {
+      const unsigned bit = BUFFERTOOLS_CTZ(mask);
+      if (memcmp(haystack + i + bit + 1, needle + 1, needle_size - 2) == 0) {
+        return haystack + i + bit;
+      }
+      mask &= mask - 1;
+    }
+  }
+
+  return search_short_scalar(haystack + i, size - i, needle, needle_size);
+}
+
+BUFFERTOOLS_TARGET("avx2")
+static const uint8_t* search_short_last_avx2(const uint8_t* haystack,
+                                             size_t size,
+                                             const uint8_t* needle,
+                                             size_t needle_size) {
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[needle_size - 1]);
+
+  size_t i = size - needle_size + 1;
+  while (i >= 32) {
+    i -= 32;
+    const __m256i block_first =
+        _mm256_loadu_si256((const __m256i*) (haystack + i));
+    const __m256i block_last =
+        _mm256_loadu_si256((const __m256i*) (haystack + i + needle_size - 1));
+    unsigned mask = _mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+                         _mm256_cmpeq_epi8(block_last, last)));
+    while (mask) {
+      const unsigned bit = 31 - BUFFERTOOLS_CLZ(mask);
+      if (memcmp(haystack + i + bit + 1, needle + 1, needle_size - 2) == 0) {
+        return haystack + i + bit;
+      }
+      mask &= ~(1u << bit);
+    }
+  }
+
+  return search_short_last_scalar(haystack,
+                                  i + needle_size - 1,
+                                  needle,
+                                  needle_size);
+}
+#endif  // BUFFERTOOLS_X86
+
+// Needle must be 2 to SEARCH_SHORT_NEEDLE bytes and fit in the haystack.
+static inline const uint8_t* search_short(const uint8_t* haystack,
+                                          size_t size,
+                                          const uint8_t* needle,
+                                          size_t needle_size) {
+#if defined(BUFFERTOOLS_X86)
+  if (cpu_has(CPU_AVX2)) {
+    return search_short_avx2(haystack, size, needle, needle_size);
+  }
+#endif
+#if defined(BUFFERTOOLS_SSE2)
+  return search_short_sse2(haystack, size, needle, needle_size);
+#else
+  return search_short_scalar(haystack, size, needle, needle_size);
+#endif
+}
+
+static inline const uint8_t* search_short_last(const uint8_t* haystack,
+                                               size_t size,
+                                               const uint8_t* needle,
+                                               size_t needle_size) {
+#if defined(BUFFERTOOLS_X86)
+  if (cpu_has(CPU_AVX2)) {
+    return search_short_last_avx2(haystack, size, needle, needle_size);
+  }
+#endif
+#if defined(BUFFERTOOLS_SSE2)
+  return search_short_last_sse2(haystack, size, needle, needle_size);
+#else
+  return search_short_last_scalar(haystack, size, needle, needle_size);
+#endif
+}
+
+static const uint8_t* search(const uint8_t* haystack,
+                             size_t size,
+                             const uint8_t* needle,
+                             size_t needle_size) {
+  if (needle_size == 0 || needle_size > size) {
+    return NULL;
+  }
+  if (needle_size == 1) {
+    return search_byte(haystack, size, needle[0]);
+  }
+  if (needle_size <= SEARCH_SHORT_NEEDLE) {
+    return search_short(haystack, size, needle, needle_size);
+  }
+  return boyermoore_search(haystack, size, needle, needle_size);
+}
+
+static const uint8_t* search_last(const uint8_t* haystack,
+                                  size_t size,
+                                  const uint8_t* needle,
+                                  size_t needle_size) {
+  if (needle_size == 0 || needle_size > size) {
+    return NULL;
+  }
+  if (needle_size == 1) {
+    return search_byte_last(haystack, size, needle[0]);
+  }
+  if (needle_size <= SEARCH_SHORT_NEEDLE) {
+    return search_short_last(haystack, size, needle, needle_size);
+  }
+
+  struct boyermoore_table table;
+  boyermoore_prepare(&table, needle, needle_size, 1);
+  const uint8_t* p = boyermoore_search_table(&table, haystack, size);
+  boyermoore_release(&table);
+  return p;
+}
+
+// A needle prepared for repeated searches. Only long needles need the
+// Boyer-Moore tables, short ones are fast to search as-is.
+struct search_pattern {
+  uint8_t* needle;
+  size_t needle_size;
+  struct boyermoore_table* forward;
+  struct boyermoore_table* reverse;
+};
+
+static void search_prepare(struct search_pattern* pattern,
+                           const uint8_t* needle,
+                           size_t needle_size) {
+  pattern->needle = new uint8_t[stats_allocation(needle_size + 1)];
+  pattern->needle_size = needle_size;
+  pattern->forward = NULL;
+  pattern->reverse = NULL;
+  if (needle_size > 0) {
+    memcpy(pattern->needle, needle, needle_size);
+  }
+
+  if (needle_size > SEARCH_SHORT_NEEDLE) {
+    pattern->forward = new boyermoore_table;
+    pattern->reverse = new boyermoore_table;
+    boyermoore_prepare(pattern->forward, needle, needle_size, 0);
+    boyermoore_prepare(pattern->reverse, needle, needle_size, 1);
+  }
+}
+
+static void search_release(struct search_pattern* pattern) {
+  if (pattern->forward) {
+    boyermoore_release(pattern->forward);
+    boyermoore_release(pattern->reverse);
+    delete pattern->forward;
+    delete pattern->reverse;
+  }
+  delete[] pattern->needle;
+  pattern->needle = NULL;
+  pattern->forward = NULL;
+  pattern->reverse = NULL;
+}
+
+static inline const uint8_t* search_pattern_first(
+    const struct search_pattern* pattern,
+    const uint8_t* haystack,
+    size_t size) {
+  if (pattern->forward) {
+    return boyermoore_search_table(pattern->forward, haystack, size);
+  }
+  return search(haystack, size, pattern->needle, pattern->needle_size);
+}
+
+static inline const uint8_t* search_pattern_last(
+    const struct search_pattern* pattern,
+    const uint8_t* haystack,
+    size_t size) {
+  if (pattern->reverse) {
+    return boyermoore_search_table(pattern->reverse, haystack, size);
+  }
+  return search_last(haystack, size, pattern->needle, pattern->needle_size);
+}
+
+#endif  // SEARCH_H
@@ -0,0 +1,278 @@
+/* Copyright (c) 2010, Ben Noordhuis <info@bnoordhuis.nl>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SORT_FIXED_H
+#define SORT_FIXED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Sorting and searching of |count| keys of |width| bytes each, packed back
+// to back. Keys are ordered by memcmp(). Nothing is allocated.
+//
+// sort_fixed() is an in-place MSD radix sort (American flag sort): every
+// pass distributes the keys over 256 buckets by one byte, then sorts each
+// bucket by the next byte. Bytes that are the same for all keys in a bucket
+// (common prefixes) are skipped without recursing. Small buckets are
+// insertion sorted. Past SORT_FIXED_RADIX_DEPTH levels of recursion,
+// buckets are introsorted on the remaining bytes instead, that caps the
+// stack use for wide keys.
+#define SORT_FIXED_SMALL 16
+#define SORT_FIXED_RADIX_DEPTH 16
+
+// Compares two keys from byte |depth| onwards.
+static inline int sort_fixed_compare(const uint8_t* a,
+                                     const uint8_t* b,
+                                     size_t width,
+                                     size_t depth) {
+  return memcmp(a + depth, b + depth, width - depth);
+}
+
+static inline void sort_fixed_swap(uint8_t* a, uint8_t* b, size_t width) {
+  size_t i = 0;
+  for (; i + 8 <= width; i += 8) {
+    uint64_t x, y;
+    memcpy(&x, a + i, 8);
+    memcpy(&y, b + i, 8);
+    memcpy(a + i, &y, 8);
+    memcpy(b + i, &x, 8);
+  }
+  for (; i < width; ++i) {
+    const uint8_t t = a[i];
+    a[i] = b[i];
+    b[i] = t;
+  }
+}
+
+static void sort_fixed_insertion(uint8_t* data,
+                                 size_t count,
+                                 size_t width,
+                                 size_t depth) {
+  for (size_t i = 1; i < count; ++i) {
+    uint8_t* p = data + i * width;
+    while (p > data && sort_fixed_compare(p - width, p, width, depth) > 0) {
+      sort_fixed_swap(p - width, p, width);
+      p -= width;
+    }
+  }
+}
+
+static void sort_fixed_sift_down(uint8_t* data,
+                                 size_t root,
+                                 size_t count,
+                                 size_t width,
+                                 size_t depth) {
+  for (;;) {
+    size_t child = 2 * root + 1;
+    if (child >= count) {
+      break;
+    }
+    if (child + 1 < count &&
+        sort_fixed_compare(data + child * width,
+                           data + (child + 1) * width,
+                           width,
+                           depth) < 0) {
+      ++child;
+    }
+    if (sort_fixed_compare(data + root * width,
+                           data + child * width,
+                           width,
+                           depth) >= 0) {
+      break;
+    }
+    sort_fixed_swap(data + root * width, data + child * width, width);
+    root = child;
+  }
+}
+
+static void sort_fixed_heap(uint8_t* data,
+                            size_t count,
+                            size_t width,
+                            size_t depth) {
+  for (size_t i = count / 2; i > 0; --i) {
+    sort_fixed_sift_down(data, i - 1, count, width, depth);
+  }
+  for (size_t n = count - 1; n > 0; --n) {
+    sort_fixed_swap(data, data + n * width, width);
+    sort_fixed_sift_down(data, 0, n, width, depth);
+  }
+}
+
+// Quicksort with a median of three pivot that falls back to heapsort when
+// it recurses too deep. Recurses on the smaller half only.
+static void sort_fixed_intro(uint8_t* data,
+                             size_t count,
+                             size_t width,
+                             size_t depth,
+                             unsigned limit) {
+  while (count > SORT_FIXED_SMALL) {
+    if (limit == 0) {
+      sort_fixed_heap(data, count, width, depth);
+      return;
+    }
+    --limit;
+
+    // Move the median of the first, middle and last key to the front.
+    uint8_t* a = data + width;
+    uint8_t* b = data + (count / 2) * width;
+    uint8_t* c = data + (count - 1) * width;
+    if (sort_fixed_compare(a, b, width, depth) > 0) {
+      sort_fixed_swap(a, b, width);
+    }
+    if (sort_fixed_compare(b, c, width, depth) > 0) {
+      sort_fixed_swap(b, c, width);
+      if (sort_fixed_compare(a, b, width, depth) > 0) {
+        sort_fixed_swap(a, b, width);
+      }
+    }
+    sort_fixed_swap(data, b, width);
+
+    // Both scans stop at keys equal to the pivot so runs of duplicates are
+    // split evenly.
+    size_t i = 0;
+    size_t j = count;
+    for (;;) {
+      while (sort_fixed_compare(data + ++i * width, data, width, depth) < 0) {
+        if (i == count - 1) {
+          break;
+        }
+      }
+      while (sort_fixed_compare(data, data + --j * width, width, depth) < 0) {
+        if (j == 0) {
+          break;
+        }
+      }
+      if (i >= j) {
+        break;
+      }
+      sort_fixed_swap(data + i * width, data + j * width, width);
+    }
+    sort_fixed_swap(data, data + j * width, width);
+
+    // [0, j) is less than or equal to the pivot at j, (j, count) is greater
+    // than or equal to it.
+    if (j < count - j - 1) {
+      sort_fixed_intro(data, j, width, depth, limit);
+      data += (j + 1) * width;
+      count -= j + 1;
+    } else {
+      sort_fixed_intro(data + (j + 1) * width,
+                       count - j - 1,
+                       width,
+                       depth,
+                       limit);
+      count = j;
+    }
+  }
+
+  sort_fixed_insertion(data, count, width, depth);
+}
+
+static void sort_fixed_radix(uint8_t* data,
+                             size_t count,
+                             size_t width,
+                             size_t depth,
+                             unsigned level) {
+  if (count <= SORT_FIXED_SMALL) {
+    sort_fixed_insertion(data, count, width, depth);
+    return;
+  }
+
+  if (level >= SORT_FIXED_RADIX_DEPTH) {
+    unsigned limit = 0;
+    for (size_t n = count; n > 1; n >>= 1) {
+      limit += 2;
+    }
+    sort_fixed_intro(data, count, width, depth, limit);
+    return;
+  }
+
+  size_t counts[256];
+  for (;; ++depth) {
+    if (depth >= width) {
+      return;  // All keys are equal.
+    }
+    memset(counts, 0, sizeof(counts));
+    for (size_t i = 0; i < count; ++i) {
+      counts[data[i * width + depth]]++;
+    }
+    if (counts[data[depth]] < count) {
+      break;
+    }
+  }
+
+  // next[b] is where the next key for bucket b goes, end[b] where the
+  // bucket ends.
+  size_t next[256];
+  size_t end[256];
+  size_t offset = 0;
+  for (size_t b = 0; b < 256; ++b) {
+    next[b] = offset;
+    offset += counts[b];
+    end[b] = offset;
+  }
+
+  // Swap every key into its bucket. A key that's already in the right
+  // bucket only advances the bucket's write position.
+  for (size_t b = 0; b < 256; ++b) {
+    while (next[b] < end[b]) {
+      uint8_t* key = data + next[b] * width;
+      const uint8_t c = key[depth];
+      if (c == b) {
+        next[b]++;
+      } else {
+        sort_fixed_swap(key, data + next[c]++ * width, width);
+      }
+    }
+  }
+
+  offset = 0;
+  for (size_t b = 0; b < 256; ++b) {
+    if (counts[b] > 1) {
+      sort_fixed_radix(data + offset * width,
+                       counts[b],
+                       width,
+                       depth + 1,
+                       level + 1);
+    }
+    offset += counts[b];
+  }
+}
+
+static inline void sort_fixed(uint8_t* data, size_t count, size_t width) {
+  sort_fixed_radix(data, count, width, 0, 0);
+}
+
+// Returns the index of the first key that is not less than |key|, or
+// |count| if there is none. |key| is |width| bytes.
+static inline size_t lower_bound_fixed(const uint8_t* data,
+                                       size_t count,
+                                       size_t width,
+                                       const uint8_t* key) {
+  size_t lo = 0;
+  size_t hi = count;
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (memcmp(data + mid * width, key, width) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+#endif  // SORT_FIXED_H
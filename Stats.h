@@ -0,0 +1,132 @@
+/* Copyright (c) 2010, Ben Noordhuis <info@bnoordhuis.nl>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(BUFFERTOOLS_USDT)
+# include <sys/sdt.h>
+#endif
+
+// Opt-in counters for the native functions: calls, bytes, allocations and a
+// latency histogram per function. The function callbacks record themselves
+// with stats_begin() and stats_end(), allocations anywhere in between are
+// added to the function that is running with stats_allocation().
+//
+// The counters are thread-local, so recording them takes no locks or atomic
+// operations. A worker thread that loads the module counts its own calls. The
+// thread pool doesn't count: work that's done there is part of the call that
+// queued it, as far as the allocations go, but its time isn't.
+//
+// Compile with -DBUFFERTOOLS_USDT to add the USDT probes buffertools:start
+// and buffertools:done, with the name of the function and the size of the
+// buffer as arguments. They fire whether or not the counters are enabled.
+#if defined(_MSC_VER)
+# define BUFFERTOOLS_THREAD_LOCAL __declspec(thread)
+#else
+# define BUFFERTOOLS_THREAD_LOCAL __thread
+#endif
+
+#if defined(BUFFERTOOLS_USDT)
+# define STATS_PROBES true
+# define STATS_PROBE(probe, name, size)                                       \
+    DTRACE_PROBE2(buffertools, probe, name, size)
+#else
+# define STATS_PROBES false
+# define STATS_PROBE(probe, name, size) ((void) 0)
+#endif
+
+#define STATS_MAX_ACTIONS 128
+
+// Bucket i counts the calls that took from 2^i up to 2^(i+1) nanoseconds.
+// The first bucket takes the calls below 2 ns, the last everything from
+// 2^31 ns, about two seconds, onwards.
+#define STATS_LATENCY_BUCKETS 32
+
+struct action_stats {
+  uint64_t calls;
+  uint64_t bytes;
+  uint64_t allocations;
+  uint64_t allocated_bytes;
+  uint64_t time;  // nanoseconds
+  uint64_t latency[STATS_LATENCY_BUCKETS];
+};
+
+// Filled in once, while the module loads.
+static const char* stats_names[STATS_MAX_ACTIONS];
+static int stats_actions;
+
+static BUFFERTOOLS_THREAD_LOCAL bool stats_enabled;
+static BUFFERTOOLS_THREAD_LOCAL action_stats* stats_current;
+static BUFFERTOOLS_THREAD_LOCAL action_stats stats_table[STATS_MAX_ACTIONS];
+
+// Returns the id to pass to stats_begin(), -1 if the table is full. Those
+// functions aren't counted.
+static inline int stats_register(const char* name) {
+  if (stats_actions == STATS_MAX_ACTIONS) {
+    return -1;
+  }
+  stats_names[stats_actions] = name;
+  return stats_actions++;
+}
+
+// Makes |action| the function that is running. Returns NULL when the
+// counters are disabled, the stats to pass to stats_end() otherwise.
+static inline action_stats* stats_begin(int action, size_t bytes) {
+  if (!stats_enabled || action < 0) {
+    return NULL;
+  }
+  action_stats* stats = &stats_table[action];
+  stats->calls += 1;
+  stats->bytes += bytes;
+  stats_current = stats;
+  return stats;
+}
+
+// Adds the |time| that the call took and makes |previous| the function that
+// is running again, that is the one that was when stats_begin() was called.
+static inline void stats_end(action_stats* stats,
+                             action_stats* previous,
+                             uint64_t time) {
+  unsigned bucket = 0;
+  for (uint64_t t = time >> 1; t != 0; t >>= 1) {
+    if (++bucket == STATS_LATENCY_BUCKETS - 1) {
+      break;
+    }
+  }
+  stats->time += time;
+  stats->latency[bucket] += 1;
+  stats_current = previous;
+}
+
+// Returns |size|, so it can wrap the size argument of the allocation.
+static inline size_t stats_allocation(size_t size) {
+  if (stats_current != NULL) {
+    stats_current->allocations += 1;
+    stats_current->allocated_bytes += size;
+  }
+  return size;
+}
+
+static inline void stats_reset() {
+  memset(stats_table, 0, sizeof(stats_table));
+}
+
+#endif  // STATS_H
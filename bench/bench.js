@@ -0,0 +1,301 @@
+/* Copyright (c) 2010, Ben Noordhuis <info@bnoordhuis.nl>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Times the native actions against their Buffer built-in counterparts and
+// prints the results as JSON, one object per line, so that runs of two
+// builds can be diffed. Usage:
+//
+//   node bench/bench.js [--filter=regex] [--max-size=bytes] [--time=ms]
+//
+// Don't call buffertools.extend() in here, it would replace the built-ins
+// that we compare against.
+var buffertools = require('../buffertools');
+var Buffer = require('buffer').Buffer;
+
+var options = {
+	filter: /./,
+	maxSize: 64 << 20,
+	time: 200
+};
+
+process.argv.slice(2).forEach(function(arg) {
+	var m = /^--([a-z-]+)=(.*)$/.exec(arg);
+	if (!m) {
+		throw new Error('Bad argument: ' + arg);
+	}
+	if (m[1] === 'filter') options.filter = new RegExp(m[2]);
+	else if (m[1] === 'max-size') options.maxSize = +m[2];
+	else if (m[1] === 'time') options.time = +m[2];
+	else throw new Error('Unknown option: ' + arg);
+});
+
+// 16 B to 64 MB.
+var SIZES = [16, 256, 4 << 10, 64 << 10, 1 << 20, 16 << 20, 64 << 20];
+
+// Single byte, SIMD filtered and Boyer-Moore needles.
+var NEEDLE_SIZES = [1, 4, 16, 64];
+
+// Where the needle sits in the haystack.
+var HITS = ['start', 'middle', 'end', 'none'];
+
+function now() {
+	var t = process.hrtime();
+	return t[0] * 1e3 + t[1] / 1e6;
+}
+
+// Calls fn() for at least options.time milliseconds and three times.
+function measure(fn) {
+	fn();  // warm up
+	var iterations = 0, batch = 1, start = now(), elapsed = 0;
+	while (elapsed < options.time || iterations < 3) {
+		for (var i = 0; i < batch; i++) fn();
+		iterations += batch;
+		elapsed = now() - start;
+		if (elapsed < options.time / 10) batch *= 2;
+	}
+	return { iterations: iterations, ms: elapsed };
+}
+
+function report(action, impl, size, params, fn) {
+	var name = action + '/' + impl;
+	if (!options.filter.test(name)) {
+		return;
+	}
+	var m = measure(fn);
+	var result = {
+		action: action,
+		impl: impl,
+		size: size,
+		opsPerSec: m.iterations / m.ms * 1e3,
+		bytesPerSec: m.iterations * size / m.ms * 1e3
+	};
+	for (var key in params) {
+		result[key] = params[key];
+	}
+	console.log(JSON.stringify(result));
+}
+
+// Printable data with few accidental matches of the needles below.
+function randomBuffer(size) {
+	var b = new Buffer(size);
+	for (var i = 0; i < size; i++) {
+		b[i] = 97 + (Math.random() * 26 | 0);
+	}
+	return b;
+}
+
+function needleAt(haystack, needle, hit) {
+	if (hit === 'start') needle.copy(haystack, 0);
+	if (hit === 'middle') needle.copy(haystack, (haystack.length - needle.length) >> 1);
+	if (hit === 'end') needle.copy(haystack, haystack.length - needle.length);
+}
+
+var sizes = SIZES.filter(function(size) { return size <= options.maxSize; });
+
+sizes.forEach(function(size) {
+	var a = randomBuffer(size), b = new Buffer(size);
+	a.copy(b);
+
+	NEEDLE_SIZES.forEach(function(needleSize) {
+		if (needleSize > size) {
+			return;
+		}
+		HITS.forEach(function(hit) {
+			var haystack = new Buffer(size);
+			a.copy(haystack);
+			// Upper case never occurs in randomBuffer().
+			var needle = new Buffer(needleSize);
+			needle.fill('Z');
+			needleAt(haystack, needle, hit);
+			var params = { needleSize: needleSize, hit: hit };
+			report('indexOf', 'buffertools', size, params, function() {
+				buffertools.indexOf(haystack, needle);
+			});
+			if (haystack.indexOf) {
+				report('indexOf', 'Buffer', size, params, function() {
+					haystack.indexOf(needle);
+				});
+			}
+		});
+	});
+
+	report('compare', 'buffertools', size, {}, function() {
+		buffertools.compare(a, b);
+	});
+	if (Buffer.compare) {
+		report('compare', 'Buffer', size, {}, function() {
+			Buffer.compare(a, b);
+		});
+	}
+
+	// |size| bytes of 40 byte keys, in one call or one call per key.
+	var keys = [];
+	for (var i = 0; i + 40 <= size; i += 40) {
+		keys.push(a.slice(i, i + 40));
+	}
+	if (keys.length > 0) {
+		var key = keys[keys.length >> 1];
+		report('compareMany', 'buffertools', size, { keys: keys.length }, function() {
+			buffertools.compareMany(keys, key);
+		});
+		var packed = a.slice(0, keys.length * 40);
+		var offsets = new Uint32Array(keys.length + 1);
+		for (var i = 0; i <= keys.length; i++) offsets[i] = i * 40;
+		report('compareMany', 'packed', size, { keys: keys.length }, function() {
+			buffertools.compareMany(packed, offsets, key);
+		});
+		report('compareMany', 'loop', size, { keys: keys.length }, function() {
+			for (var i = 0; i < keys.length; i++) buffertools.compare(keys[i], key);
+		});
+	}
+
+	// |size| bytes of 40 byte records, split in one call or with indexOf().
+	var records = new Buffer(size);
+	a.copy(records);
+	for (var i = 39; i < size; i += 40) records[i] = 10;
+	report('split', 'buffertools', size, {}, function() {
+		buffertools.split(records, '\n');
+	});
+	report('split', 'loop', size, {}, function() {
+		var fields = [];
+		for (var start = 0, end; (end = buffertools.indexOf(records, '\n', start)) !== -1; start = end + 1) {
+			fields.push(records.slice(start, end));
+		}
+		fields.push(records.slice(start));
+	});
+
+	report('equals', 'buffertools', size, {}, function() {
+		buffertools.equals(a, b);
+	});
+	report('timingSafeEquals', 'buffertools', size, {}, function() {
+		buffertools.timingSafeEquals(a, b);
+	});
+	if (a.equals) {
+		report('equals', 'Buffer', size, {}, function() {
+			a.equals(b);
+		});
+	}
+
+	[1, 3, 16].forEach(function(patternSize) {
+		var pattern = new Buffer(patternSize);
+		pattern.fill('x');
+		var params = { patternSize: patternSize };
+		report('fill', 'buffertools', size, params, function() {
+			buffertools.fill(b, pattern);
+		});
+		report('fill', 'Buffer', size, params, function() {
+			b.fill(pattern.toString());
+		});
+	});
+
+	// 16 byte keys, re-shuffled before every sort.
+	if (size >= 16) {
+		var sorted = new Buffer(size - size % 16);
+		report('sortFixed', 'buffertools', size, { keyWidth: 16 }, function() {
+			a.copy(sorted, 0, 0, sorted.length);
+			buffertools.sortFixed(sorted, 16);
+		});
+	}
+
+	report('count', 'buffertools', size, {}, function() {
+		buffertools.count(a, 'q');
+	});
+	report('count', 'loop', size, {}, function() {
+		for (var i = 0, n = 0; i < a.length; i++) n += a[i] === 113;
+	});
+	report('histogram', 'buffertools', size, {}, function() {
+		buffertools.histogram(a);
+	});
+	report('isUtf8', 'buffertools', size, {}, function() {
+		buffertools.isUtf8(a);
+	});
+	report('isUtf8', 'Buffer', size, {}, function() {
+		new Buffer(a.toString()).equals(a);
+	});
+	report('findFirstOf', 'buffertools', size, {}, function() {
+		buffertools.findFirstOf(a, 'XYZ');
+	});
+	report('findFirstOf', 'loop', size, {}, function() {
+		for (var i = 0; i < a.length; i++) {
+			var c = a[i];
+			if (c === 88 || c === 89 || c === 90) break;
+		}
+	});
+
+	report('crc32c', 'buffertools', size, {}, function() {
+		buffertools.crc32c(a);
+	});
+	report('hash64', 'buffertools', size, {}, function() {
+		buffertools.hash64(a);
+	});
+
+	report('reverse', 'buffertools', size, {}, function() {
+		buffertools.reverse(b);
+	});
+	report('reverse', 'Buffer', size, {}, function() {
+		Array.prototype.reverse.call(b);
+	});
+
+	report('toHex', 'buffertools', size, {}, function() {
+		buffertools.toHex(a);
+	});
+	report('toHex', 'Buffer', size, {}, function() {
+		a.toString('hex');
+	});
+
+	// Decodes |size| bytes of hex digits.
+	var hex = new Buffer(a.slice(0, size >> 1).toString('hex'));
+	var hexString = hex.toString('binary');
+	report('fromHex', 'buffertools', size, {}, function() {
+		buffertools.fromHex(hex);
+	});
+	report('fromHex', 'Buffer', size, {}, function() {
+		new Buffer(hexString, 'hex');
+	});
+
+	report('toBase64', 'buffertools', size, {}, function() {
+		buffertools.toBase64(a);
+	});
+	report('toBase64', 'Buffer', size, {}, function() {
+		a.toString('base64');
+	});
+	report('toBase32', 'buffertools', size, {}, function() {
+		buffertools.toBase32(a);
+	});
+
+	// Decodes |size| bytes of base64.
+	var base64 = new Buffer(a.slice(0, size / 4 * 3).toString('base64'));
+	var base64String = base64.toString('binary');
+	report('fromBase64', 'buffertools', size, {}, function() {
+		buffertools.fromBase64(base64);
+	});
+	report('fromBase64', 'Buffer', size, {}, function() {
+		new Buffer(base64String, 'base64');
+	});
+
+	// Joins |size| bytes from 16 parts.
+	var parts = [];
+	for (var i = 0; i < 16; i++) {
+		parts.push(a.slice(i * size >> 4, (i + 1) * size >> 4));
+	}
+	report('concat', 'buffertools', size, { parts: parts.length }, function() {
+		buffertools.concat.apply(buffertools, parts);
+	});
+	if (Buffer.concat) {
+		report('concat', 'Buffer', size, { parts: parts.length }, function() {
+			Buffer.concat(parts, size);
+		});
+	}
+});
@@ -0,0 +1,59 @@
+/* Copyright (c) 2010, Ben Noordhuis <info@bnoordhuis.nl>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Compares two outputs of bench.js and prints the relative change in
+// throughput for every case, slowest first. Usage:
+//
+//   node bench/compare.js before.json after.json
+var fs = require('fs');
+
+function load(filename) {
+	var results = {};
+	fs.readFileSync(filename, 'utf8').split('\n').forEach(function(line) {
+		if (line.trim() === '') {
+			return;
+		}
+		var result = JSON.parse(line);
+		var key = [];
+		for (var name in result) {
+			if (name !== 'opsPerSec' && name !== 'bytesPerSec') {
+				key.push(name + '=' + result[name]);
+			}
+		}
+		results[key.join(' ')] = result.opsPerSec;
+	});
+	return results;
+}
+
+if (process.argv.length !== 4) {
+	console.error('Usage: node bench/compare.js before.json after.json');
+	process.exit(1);
+}
+
+var before = load(process.argv[2]);
+var after = load(process.argv[3]);
+var changes = [];
+
+for (var key in before) {
+	if (key in after) {
+		changes.push({ key: key, change: after[key] / before[key] - 1 });
+	}
+}
+
+changes.sort(function(a, b) { return a.change - b.change; });
+changes.forEach(function(c) {
+	var percent = (c.change * 100).toFixed(1);
+	console.log((c.change < 0 ? '' : '+') + percent + '%\t' + c.key);
+});
@@ -13,18 +13,36 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-#include "BoyerMoore.h"
+#include "AhoCorasick.h"
+#include "Base32.h"
+#include "Base64.h"
+#include "Bitwise.h"
+#include "ByteOrder.h"
+#include "Compare.h"
+#include "Fill.h"
+#include "Hash.h"
+#include "Hex.h"
+#include "MappedFile.h"
+#include "Scan.h"
+#include "Search.h"
+#include "SortFixed.h"
+#include "Stats.h"
 #include "node.h"
 #include "node_buffer.h"
+#include "node_object_wrap.h"
 #include "node_version.h"
+#include "uv.h"
 #include "v8.h"
 
 #include <algorithm>
+#include <deque>
+#include <map>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <string>
+#include <vector>
 
 namespace {
 
@@ -36,27 +54,92 @@ using v8::String;
 using v8::Value;
 
 #if NODE_MAJOR_VERSION > 0 || NODE_MINOR_VERSION > 10
+# define UNI_AFTER_WORK_CALLBACK(name)                                        \
+    void name(uv_work_t* req, int status)
+# define UNI_ARRAY_NEW(length)                                                \
+    v8::Array::New(args.GetIsolate(), length)
 # define UNI_BOOLEAN_NEW(value)                                               \
     v8::Boolean::New(args.GetIsolate(), value)
 # if NODE_MAJOR_VERSION >= 3
 #  define UNI_BUFFER_NEW(size)                                                \
-    node::Buffer::New(args.GetIsolate(), size).ToLocalChecked()
+    node::Buffer::New(args.GetIsolate(), stats_allocation(size))             \
+        .ToLocalChecked()
+#  define UNI_BUFFER_NEW_EXTERNAL(data, size, callback, hint)                 \
+    node::Buffer::New(args.GetIsolate(), data, size, callback, hint)          \
+        .ToLocalChecked()
+#  define UNI_FUNCTION_NEW_INSTANCE(handle, argc, argv)                       \
+    v8::Local<v8::Function>::New(args.GetIsolate(), handle)                   \
+        ->NewInstance(args.GetIsolate()->GetCurrentContext(), argc, argv)     \
+        .FromMaybe(v8::Local<v8::Object>())
+#  define UNI_STRING_NEW_EXTERNAL(resource)                                   \
+    v8::String::NewExternalOneByte(v8::Isolate::GetCurrent(), resource)       \
+        .FromMaybe(v8::Local<v8::String>())
+#  define UNI_STRING_NEW_ONE_BYTE(data, size)                                 \
+    v8::String::NewFromOneByte(args.GetIsolate(),                             \
+                               data,                                          \
+                               v8::NewStringType::kNormal,                    \
+                               size).ToLocalChecked()
 # else
 #  define UNI_BUFFER_NEW(size)                                                \
-    node::Buffer::New(args.GetIsolate(), size)
+    node::Buffer::New(args.GetIsolate(), stats_allocation(size))
+#  define UNI_BUFFER_NEW_EXTERNAL(data, size, callback, hint)                 \
+    node::Buffer::New(args.GetIsolate(), data, size, callback, hint)
+#  define UNI_FUNCTION_NEW_INSTANCE(handle, argc, argv)                       \
+    v8::Local<v8::Function>::New(args.GetIsolate(), handle)                   \
+        ->NewInstance(argc, argv)
+#  define UNI_STRING_NEW_EXTERNAL(resource)                                   \
+    v8::String::NewExternal(v8::Isolate::GetCurrent(), resource)
+#  define UNI_STRING_NEW_ONE_BYTE(data, size)                                 \
+    v8::String::NewFromOneByte(args.GetIsolate(),                             \
+                               data,                                          \
+                               v8::String::kNormalString,                     \
+                               size)
 # endif  // NODE_MAJOR_VERSION >= 3
+# if NODE_MAJOR_VERSION >= 12
+#  define UNI_BUFFER_DETACH(buffer)                                           \
+    (buffer).As<v8::Uint8Array>()->Buffer()->Detach()
+# elif NODE_MAJOR_VERSION >= 4
+#  define UNI_BUFFER_DETACH(buffer)                                           \
+    (buffer).As<v8::Uint8Array>()->Buffer()->Neuter()
+# else
+#  define UNI_BUFFER_DETACH(buffer)                                           \
+    (void) (buffer)  // not a typed array yet
+# endif  // NODE_MAJOR_VERSION >= 12
+# if NODE_MAJOR_VERSION >= 1
+typedef v8::String::ExternalOneByteStringResource ExternalOneByteResource;
+# else
+typedef v8::String::ExternalAsciiStringResource ExternalOneByteResource;
+# endif  // NODE_MAJOR_VERSION >= 1
 # define UNI_CONST_ARGUMENTS(name)                                            \
     const v8::FunctionCallbackInfo<v8::Value>& name
+# define UNI_CURRENT_HANDLESCOPE()                                            \
+    v8::HandleScope handle_scope(v8::Isolate::GetCurrent())
+# define UNI_CURRENT_INTEGER_NEW(value)                                       \
+    v8::Integer::New(v8::Isolate::GetCurrent(), value)
+# define UNI_CURRENT_NULL()                                                   \
+    v8::Null(v8::Isolate::GetCurrent())
+# define UNI_CURRENT_STRING_NEW(string)                                       \
+    v8::String::NewFromUtf8(v8::Isolate::GetCurrent(), string)
 # define UNI_ESCAPE(value)                                                    \
     return handle_scope.Escape(value)
 # define UNI_ESCAPABLE_HANDLESCOPE()                                          \
     v8::EscapableHandleScope handle_scope(args.GetIsolate())
 # define UNI_FUNCTION_CALLBACK(name)                                          \
     void name(const v8::FunctionCallbackInfo<v8::Value>& args)
+# define UNI_FUNCTION_TEMPLATE_NEW(callback)                                  \
+    v8::FunctionTemplate::New(v8::Isolate::GetCurrent(), callback)
 # define UNI_HANDLESCOPE()                                                    \
     v8::HandleScope handle_scope(args.GetIsolate())
 # define UNI_INTEGER_NEW(value)                                               \
     v8::Integer::New(args.GetIsolate(), value)
+# define UNI_MAKE_CALLBACK(recv, callback, argc, argv)                        \
+    node::MakeCallback(v8::Isolate::GetCurrent(), recv, callback, argc, argv)
+# define UNI_PERSISTENT_DISPOSE(handle)                                       \
+    (handle).Reset()
+# define UNI_PERSISTENT_LOCAL(type, handle)                                   \
+    v8::Local<type>::New(v8::Isolate::GetCurrent(), handle)
+# define UNI_PERSISTENT_RESET(handle, value)                                  \
+    (handle).Reset(v8::Isolate::GetCurrent(), value)
 # define UNI_RETURN(value)                                                    \
     args.GetReturnValue().Set(value)
 # define UNI_STRING_EMPTY()                                                   \
@@ -75,33 +158,80 @@ using v8::Value;
 # define UNI_THROW_EXCEPTION(type, message)                                   \
     args.GetIsolate()->ThrowException(                                        \
         type(v8::String::NewFromUtf8(args.GetIsolate(), message)));
+# define UNI_THROW_ERRNO(errorno, syscall, path)                              \
+    args.GetIsolate()->ThrowException(                                        \
+        node::ErrnoException(args.GetIsolate(), errorno, syscall, NULL, path))
+# define UNI_UINT32_NEW(value)                                                \
+    v8::Integer::NewFromUnsigned(args.GetIsolate(), value)
 #else  // NODE_MAJOR_VERSION > 0 || NODE_MINOR_VERSION > 10
+# define UNI_AFTER_WORK_CALLBACK(name)                                        \
+    void name(uv_work_t* req)
+# define UNI_ARRAY_NEW(length)                                                \
+    v8::Array::New(length)
 # define UNI_BOOLEAN_NEW(value)                                               \
     v8::Local<v8::Boolean>::New(v8::Boolean::New(value))
 # define UNI_BUFFER_NEW(size)                                                 \
-    v8::Local<v8::Object>::New(node::Buffer::New(size)->handle_)
+    v8::Local<v8::Object>::New(                                               \
+        node::Buffer::New(stats_allocation(size))->handle_)
+# define UNI_BUFFER_DETACH(buffer)                                            \
+    (void) (buffer)
+# define UNI_BUFFER_NEW_EXTERNAL(data, size, callback, hint)                  \
+    v8::Local<v8::Object>::New(                                               \
+        node::Buffer::New(data, size, callback, hint)->handle_)
 # define UNI_CONST_ARGUMENTS(name)                                            \
     const v8::Arguments& name
+# define UNI_CURRENT_HANDLESCOPE()                                            \
+    v8::HandleScope handle_scope
+# define UNI_CURRENT_INTEGER_NEW(value)                                       \
+    v8::Integer::New(value)
+# define UNI_CURRENT_NULL()                                                   \
+    v8::Null()
+# define UNI_CURRENT_STRING_NEW(string)                                       \
+    v8::String::New(string)
 # define UNI_ESCAPE(value)                                                    \
     return handle_scope.Close(value)
 # define UNI_ESCAPABLE_HANDLESCOPE()                                          \
     v8::HandleScope handle_scope
 # define UNI_FUNCTION_CALLBACK(name)                                          \
     v8::Handle<v8::Value> name(const v8::Arguments& args)
+# define UNI_FUNCTION_NEW_INSTANCE(handle, argc, argv)                        \
+    (handle)->NewInstance(argc, argv)
+# define UNI_FUNCTION_TEMPLATE_NEW(callback)                                  \
+    v8::FunctionTemplate::New(callback)
 # define UNI_HANDLESCOPE()                                                    \
     v8::HandleScope handle_scope
 # define UNI_INTEGER_NEW(value)                                               \
     v8::Integer::New(value)
+# define UNI_MAKE_CALLBACK(recv, callback, argc, argv)                        \
+    node::MakeCallback(recv, callback, argc, argv)
+# define UNI_PERSISTENT_DISPOSE(handle)                                       \
+    (handle).Dispose()
+# define UNI_PERSISTENT_LOCAL(type, handle)                                   \
+    v8::Local<type>::New(handle)
+# define UNI_PERSISTENT_RESET(handle, value)                                  \
+    do {                                                                      \
+      (handle).Dispose();                                                     \
+      (handle) = (handle).New(value);                                         \
+    } while (0)
 # define UNI_RETURN(value)                                                    \
     return handle_scope.Close(value)
 # define UNI_STRING_EMPTY()                                                   \
     v8::String::Empty()
 # define UNI_STRING_NEW(string, size)                                         \
     v8::String::New(string, size)
+# define UNI_STRING_NEW_EXTERNAL(resource)                                    \
+    v8::String::NewExternal(resource)
+# define UNI_STRING_NEW_ONE_BYTE(data, size)                                  \
+    v8::String::New((const char*) (data), size)
 # define UNI_THROW_AND_RETURN(type, message)                                  \
     return v8::ThrowException(v8::String::New(message))
 # define UNI_THROW_EXCEPTION(type, message)                                   \
     v8::ThrowException(v8::String::New(message))
+# define UNI_THROW_ERRNO(errorno, syscall, path)                              \
+    v8::ThrowException(node::ErrnoException(errorno, syscall, "", path))
+# define UNI_UINT32_NEW(value)                                                \
+    v8::Integer::NewFromUnsigned(value)
+typedef v8::String::ExternalAsciiStringResource ExternalOneByteResource;
 #endif  // NODE_MAJOR_VERSION > 0 || NODE_MINOR_VERSION > 10
 
 #if defined(_WIN32)
@@ -122,6 +252,119 @@ inline int snprintf(char* buf, size_t size, const char* fmt, ...) {
 }
 #endif
 
+//
+// strings
+//
+// String arguments are written straight into their destination with
+// WriteUtf8() or WriteOneByte() instead of going through a heap allocated
+// String::Utf8Value copy. 'ascii' is the same as 'latin1', like in node.
+enum StringEncoding {
+  kUtf8,
+  kLatin1
+};
+
+// Parses an encoding argument. Anything that isn't a string selects UTF-8.
+// Names are matched case-insensitively, like Buffer.isEncoding(). Throws and
+// returns false if it's an encoding we don't know.
+bool stringEncoding(StringEncoding* encoding,
+                    Local<Value> value,
+                    UNI_CONST_ARGUMENTS(args)) {
+  *encoding = kUtf8;
+  if (!value->IsString()) {
+    return true;
+  }
+
+  char name[8];
+  const int length = value->ToString()->WriteUtf8(name,
+                                                  sizeof(name),
+                                                  NULL,
+                                                  String::NO_NULL_TERMINATION);
+  std::string s(name, length);
+  for (size_t i = 0; i < s.size(); i++) {
+    if (s[i] >= 'A' && s[i] <= 'Z') {
+      s[i] += 'a' - 'A';
+    }
+  }
+  if (s == "utf8" || s == "utf-8") {
+    return true;
+  }
+  if (s == "latin1" || s == "binary" || s == "ascii") {
+    *encoding = kLatin1;
+    return true;
+  }
+
+  UNI_THROW_EXCEPTION(Exception::TypeError,
+                      "Encoding should be 'utf8', 'latin1' or 'ascii'.");
+  return false;
+}
+
+// The number of bytes that |s| takes up in |encoding|.
+size_t stringLength(Local<String> s, StringEncoding encoding) {
+  return encoding == kLatin1 ? s->Length() : s->Utf8Length();
+}
+
+// Writes |s| to |data|, which has room for |size| bytes. Returns the number
+// of bytes written.
+size_t stringWrite(uint8_t* data,
+                   size_t size,
+                   Local<String> s,
+                   StringEncoding encoding) {
+  if (encoding == kUtf8) {
+    return s->WriteUtf8((char*) data, size, NULL, String::NO_NULL_TERMINATION);
+  }
+
+  const int length = std::min<size_t>(size, s->Length());
+#if NODE_MAJOR_VERSION > 0 || NODE_MINOR_VERSION > 10
+  return s->WriteOneByte(data, 0, length, String::NO_NULL_TERMINATION);
+#else
+  // No WriteOneByte() in this V8, narrow the UTF-16 code units in place.
+  uint16_t units[256];
+  for (int start = 0; start < length; start += 256) {
+    const int n = s->Write(units,
+                           start,
+                           std::min(256, length - start),
+                           String::NO_NULL_TERMINATION);
+    for (int i = 0; i < n; ++i) {
+      data[start + i] = (uint8_t) units[i];
+    }
+  }
+  return length;
+#endif
+}
+
+// The bytes of a string argument. Short strings are written to a buffer on
+// the stack in a single pass, without measuring them first.
+class StringBytes {
+ public:
+  StringBytes(Local<Value> value, StringEncoding encoding = kUtf8)
+      : data_(inline_) {
+    Local<String> s = value->ToString();
+    // A UTF-16 code unit takes up at most three bytes in UTF-8.
+    const size_t worst = encoding == kLatin1 ? s->Length() : s->Length() * 3;
+    size_t size = worst;
+    if (worst > sizeof(inline_)) {
+      size = stringLength(s, encoding);
+      if (size > sizeof(inline_)) {
+        heap_.resize(size);
+        data_ = &heap_[0];
+      }
+    }
+    length_ = stringWrite(data_, size, s, encoding);
+  }
+
+  const uint8_t* data() const { return data_; }
+  size_t length() const { return length_; }
+
+ private:
+  StringBytes(const StringBytes&);
+  void operator=(const StringBytes&);
+
+  uint8_t inline_[256];
+  std::vector<uint8_t> heap_;
+  uint8_t* data_;
+  size_t length_;
+};
+
 // this is an application of the Curiously Recurring Template Pattern
 template <class Derived> struct UnaryAction {
   Local<Value> apply(Local<Object> buffer,
@@ -138,7 +381,7 @@ template <class Derived> struct UnaryAction {
     } else if (node::Buffer::HasInstance(args[0])) {
       // First argument is the target buffer.
       args_start = 1;
-      target = args[0]->ToObject();
+      target = args[0].As<Object>();
     } else {
       UNI_THROW_EXCEPTION(Exception::TypeError,
                           "Argument should be a buffer object.");
@@ -150,6 +393,11 @@ template <class Derived> struct UnaryAction {
 };
 
 template <class Derived> struct BinaryAction {
+  static const int kEncodingArgument = 1;
+  // True if the argument before the encoding is an optional offset. The
+  // offset can then be left out and the encoding passed in its place.
+  static const bool kOptionalOffset = false;
+
   Local<Value> apply(Local<Object> buffer,
                      const uint8_t* data,
                      size_t size,
@@ -166,7 +414,7 @@ template <class Derived> struct BinaryAction {
     } else if (node::Buffer::HasInstance(args[0])) {
       // First argument is the target buffer.
       args_start = 1;
-      target = args[0]->ToObject();
+      target = args[0].As<Object>();
     } else {
       UNI_THROW_EXCEPTION(Exception::TypeError,
                           "Argument should be a buffer object.");
@@ -174,17 +422,28 @@ template <class Derived> struct BinaryAction {
     }
 
     if (args[args_start]->IsString()) {
-      String::Utf8Value s(args[args_start]);
+      // Derived::kEncodingArgument is where the optional encoding is,
+      // counted from the operand, or 0 if there is none.
+      StringEncoding encoding = kUtf8;
+      uint32_t index = args_start + Derived::kEncodingArgument;
+      if (Derived::kOptionalOffset && args[index - 1]->IsString()) {
+        index -= 1;
+      }
+      if (Derived::kEncodingArgument > 0 &&
+          !stringEncoding(&encoding, args[index], args)) {
+        return Local<Value>();
+      }
+      StringBytes s(args[args_start], encoding);
       UNI_ESCAPE(static_cast<Derived*>(this)->apply(
           target,
-          (const uint8_t*) *s,
+          s.data(),
           s.length(),
           args,
           args_start));
     }
 
     if (node::Buffer::HasInstance(args[args_start])) {
-      Local<Object> other = args[args_start]->ToObject();
+      Local<Object> other = args[args_start].As<Object>();
       UNI_ESCAPE(static_cast<Derived*>(this)->apply(
           target,
           (const uint8_t*) node::Buffer::Data(other),
@@ -209,32 +468,118 @@ Local<Value> clear(Local<Object> buffer, int c) {
   return buffer;
 }
 
-Local<Value> fill(Local<Object> buffer, void* pattern, size_t size) {
-  size_t length = node::Buffer::Length(buffer);
-  uint8_t* data = (uint8_t*) node::Buffer::Data(buffer);
+enum TypedArrayType {
+  kInt32Array,
+  kUint32Array,
+  kUint8Array,
+  kFloat64Array
+};
 
-  if (size >= length) {
-    memcpy(data, pattern, length);
-  } else {
-    const int n_copies = length / size;
-    const int remainder = length % size;
-    for (int i = 0; i < n_copies; i++) {
-      memcpy(data + size * i, pattern, size);
-    }
-    memcpy(data + size * n_copies, pattern, remainder);
+// Returns a pointer to the elements of a typed array and stores the number
+// of elements in |length|. Returns NULL if |value| is not a typed array of
+// the requested type.
+void* typedArrayData(Local<Value> value, TypedArrayType type, size_t* length) {
+#if NODE_MAJOR_VERSION > 0 || NODE_MINOR_VERSION > 10
+  if (!((type == kInt32Array && value->IsInt32Array()) ||
+        (type == kUint32Array && value->IsUint32Array()) ||
+        (type == kUint8Array && value->IsUint8Array()) ||
+        (type == kFloat64Array && value->IsFloat64Array()))) {
+    return NULL;
+  }
+  Local<v8::TypedArray> array = value.As<v8::TypedArray>();
+  *length = array->Length();
+  return static_cast<char*>(array->Buffer()->GetContents().Data()) +
+         array->ByteOffset();
+#else
+  static const v8::ExternalArrayType types[] = {
+    v8::kExternalIntArray,
+    v8::kExternalUnsignedIntArray,
+    v8::kExternalUnsignedByteArray,
+    v8::kExternalDoubleArray
+  };
+  if (!value->IsObject()) {
+    return NULL;
   }
+  Local<Object> array = value->ToObject();
+  if (!array->HasIndexedPropertiesInExternalArrayData() ||
+      array->GetIndexedPropertiesExternalArrayDataType() != types[type]) {
+    return NULL;
+  }
+  *length = array->GetIndexedPropertiesExternalArrayDataLength();
+  return array->GetIndexedPropertiesExternalArrayData();
+#endif
+}
 
-  return buffer;
+// Turns a start offset into an index into a buffer of the given size.
+// Negative offsets count from the end, out of range offsets are clamped.
+size_t clampOffset(int32_t offset, size_t size) {
+  if (offset < 0)
+    return size - std::min<size_t>(size, -static_cast<int64_t>(offset));
+  return std::min<size_t>(size, offset);
 }
 
-int compare(Local<Object> buffer, const uint8_t* data2, size_t length2) {
-  size_t length = node::Buffer::Length(buffer);
+// Shorter is smaller, the contents only matter if the lengths are equal.
+// Returns -1, 0 or 1.
+int compare(const uint8_t* data,
+            size_t length,
+            const uint8_t* data2,
+            size_t length2) {
   if (length != length2) {
     return length > length2 ? 1 : -1;
   }
+  if (data == data2) {
+    return 0;
+  }
+  return mem_compare(data, data2, length);
+}
 
-  const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
-  return memcmp(data, data2, length);
+// Parses optional start and end arguments into a range of something that is
+// |length| bytes long, the way Buffer#slice() does. Undefined and callbacks
+// count as missing.
+void sliceRange(size_t* start,
+                size_t* end,
+                size_t length,
+                Local<Value> start_arg,
+                Local<Value> end_arg) {
+  *start = 0;
+  *end = length;
+  if (!start_arg->IsUndefined() && !start_arg->IsFunction()) {
+    *start = clampOffset(start_arg->Int32Value(), length);
+  }
+  if (!end_arg->IsUndefined() && !end_arg->IsFunction()) {
+    *end = std::max(*start, clampOffset(end_arg->Int32Value(), length));
+  }
+}
+
+// Mapped buffers are found again by address, from the start of their
+// mapping. munmap() takes the entry out, the mapped_file itself lives until
+// the buffer is garbage collected.
+typedef std::map<const uint8_t*, mapped_file*> MappedFiles;
+MappedFiles mapped_files;
+
+// The mapping that |data| points into, or mapped_files.end().
+MappedFiles::iterator findMappedFile(const uint8_t* data) {
+  MappedFiles::iterator it = mapped_files.upper_bound(data);
+  if (it == mapped_files.begin()) {
+    return mapped_files.end();
+  }
+  --it;
+  if (data >= it->first + it->second->size) {
+    return mapped_files.end();
+  }
+  return it;
+}
+
+// Buffers from mmap() are read-only until munmap(). Throws and returns false
+// if |buffer| is one of them, or a slice of one.
+bool writableBuffer(Local<Object> buffer, UNI_CONST_ARGUMENTS(args)) {
+  if (findMappedFile((const uint8_t*) node::Buffer::Data(buffer)) ==
+      mapped_files.end()) {
+    return true;
+  }
+  UNI_THROW_EXCEPTION(Exception::TypeError,
+                      "Buffer is memory mapped and read-only.");
+  return false;
 }
 
 //
@@ -244,29 +589,70 @@ struct ClearAction: UnaryAction<ClearAction> {
   Local<Value> apply(Local<Object> buffer,
                      UNI_CONST_ARGUMENTS(args),
                      uint32_t args_start) {
+    if (!writableBuffer(buffer, args)) {
+      return Local<Value>();
+    }
     return clear(buffer, 0);
   }
 };
 
+// Parses the optional start, end and encoding arguments of fill() at
+// args[index...], in the order of Buffer#fill(). The encoding can also come
+// right after the value. A callback, for the async variant, counts as a
+// missing argument. Throws and returns false on an unknown encoding.
+bool fillRange(size_t* start,
+               size_t* end,
+               StringEncoding* encoding,
+               Local<Object> buffer,
+               UNI_CONST_ARGUMENTS(args),
+               uint32_t index) {
+  *start = 0;
+  *end = node::Buffer::Length(buffer);
+
+  Local<Value> arg = args[index];
+  if (!arg->IsString()) {
+    sliceRange(start,
+               end,
+               node::Buffer::Length(buffer),
+               arg,
+               args[index + 1]);
+    arg = args[index + 2];
+  }
+
+  return stringEncoding(encoding, arg, args);
+}
+
 struct FillAction: UnaryAction<FillAction> {
   Local<Value> apply(Local<Object> buffer,
                      UNI_CONST_ARGUMENTS(args),
                      uint32_t args_start) {
+    size_t start, end;
+    StringEncoding encoding;
+    if (!writableBuffer(buffer, args) ||
+        !fillRange(&start, &end, &encoding, buffer, args, args_start + 1)) {
+      return Local<Value>();
+    }
+    uint8_t* data = (uint8_t*) node::Buffer::Data(buffer) + start;
+    const size_t length = end - start;
+
     if (args[args_start]->IsInt32()) {
-      int c = args[args_start]->Int32Value();
-      return clear(buffer, c);
+      memset(data, args[args_start]->Int32Value(), length);
+      return buffer;
     }
 
     if (args[args_start]->IsString()) {
-      String::Utf8Value s(args[args_start]);
-      return fill(buffer, *s, s.length());
+      StringBytes s(args[args_start], encoding);
+      fill_pattern(data, length, s.data(), s.length());
+      return buffer;
     }
 
     if (node::Buffer::HasInstance(args[args_start])) {
       Local<Object> other = args[args_start]->ToObject();
-      size_t length = node::Buffer::Length(other);
-      uint8_t* data = (uint8_t*) node::Buffer::Data(other);
-      return fill(buffer, data, length);
+      fill_pattern(data,
+                   length,
+                   node::Buffer::Data(other),
+                   node::Buffer::Length(other));
+      return buffer;
     }
 
     UNI_THROW_EXCEPTION(Exception::TypeError,
@@ -277,47 +663,308 @@ struct FillAction: UnaryAction<FillAction> {
 };
 
 struct ReverseAction: UnaryAction<ReverseAction> {
-  // O(n/2) for all cases which is okay, might be optimized some more with whole-word swaps
-  // XXX won't this trash the L1 cache something awful?
   Local<Value> apply(Local<Object> buffer,
                      UNI_CONST_ARGUMENTS(args),
                      uint32_t args_start) {
-    uint8_t* head = (uint8_t*) node::Buffer::Data(buffer);
-    uint8_t* tail = head + node::Buffer::Length(buffer);
+    if (!writableBuffer(buffer, args)) {
+      return Local<Value>();
+    }
+    reverse_bytes((uint8_t*) node::Buffer::Data(buffer),
+                  node::Buffer::Length(buffer));
+    return buffer;
+  }
+};
+
+// Reverses the byte order of every |Width| bytes wide element.
+template <size_t Width>
+struct SwapAction: UnaryAction<SwapAction<Width> > {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    if (!writableBuffer(buffer, args)) {
+      return Local<Value>();
+    }
+    const size_t size = node::Buffer::Length(buffer);
+
+    if (size % Width) {
+      char errmsg[256];
+      snprintf(errmsg,
+               sizeof(errmsg),
+               "Buffer size must be a multiple of %lu bytes.",
+               static_cast<unsigned long>(Width));
+      UNI_THROW_EXCEPTION(Exception::RangeError, errmsg);
+      return Local<Value>();
+    }
+
+    byteswap((uint8_t*) node::Buffer::Data(buffer), size, Width);
+    return buffer;
+  }
+};
+
+typedef SwapAction<2> Swap16Action;
+typedef SwapAction<4> Swap32Action;
+typedef SwapAction<8> Swap64Action;
+
+// Returns an 8 byte buffer with |hash| in big endian order, the canonical
+// representation of xxHash64.
+Local<Object> hashBuffer(uint64_t hash, UNI_CONST_ARGUMENTS(args)) {
+  Local<Object> buffer = UNI_BUFFER_NEW(8);
+  uint8_t* data = (uint8_t*) node::Buffer::Data(buffer);
+  for (int i = 7; i >= 0; --i) {
+    data[i] = (uint8_t) hash;
+    hash >>= 8;
+  }
+  return buffer;
+}
+
+// The seed is optional, negative seeds wrap around.
+uint64_t hashSeed(Local<Value> seed) {
+  return seed->IsUndefined() ? 0 : (uint64_t) seed->IntegerValue();
+}
+
+struct Crc32cAction: UnaryAction<Crc32cAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    const uint32_t prev = args[args_start]->Uint32Value();
+    const uint32_t crc = crc32c(prev,
+                                (const uint8_t*) node::Buffer::Data(buffer),
+                                node::Buffer::Length(buffer));
+    return UNI_UINT32_NEW(crc);
+  }
+};
+
+struct Hash64Action: UnaryAction<Hash64Action> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    const uint64_t hash = xxh64((const uint8_t*) node::Buffer::Data(buffer),
+                                node::Buffer::Length(buffer),
+                                hashSeed(args[args_start]));
+    return hashBuffer(hash, args);
+  }
+};
+
+// Returns the key width argument of the packed key actions and stores the
+// number of keys in |count|. Throws and returns 0 if the width isn't a
+// positive integer or the buffer size isn't a multiple of it.
+size_t keyWidth(Local<Object> buffer,
+                UNI_CONST_ARGUMENTS(args),
+                uint32_t index,
+                size_t* count) {
+  const int32_t width = args[index]->Int32Value();
+  if (width < 1) {
+    UNI_THROW_EXCEPTION(Exception::RangeError,
+                        "Key width should be a positive integer.");
+    return 0;
+  }
+
+  const size_t size = node::Buffer::Length(buffer);
+  if (size % width) {
+    UNI_THROW_EXCEPTION(Exception::RangeError,
+                        "Buffer size must be a multiple of the key width.");
+    return 0;
+  }
+
+  *count = size / width;
+  return width;
+}
+
+// Looks up the key that follows the key width in the sorted keys. Returns
+// the index of the first key that is not less than it or, if |exact|, the
+// index of a matching key or -1.
+Local<Value> searchFixed(Local<Object> buffer,
+                         UNI_CONST_ARGUMENTS(args),
+                         uint32_t args_start,
+                         bool exact) {
+  size_t count;
+  const size_t width = keyWidth(buffer, args, args_start, &count);
+  if (width == 0) {
+    return Local<Value>();
+  }
+
+  Local<Value> arg = args[args_start + 1];
+  std::string string;
+  const uint8_t* key;
+  size_t key_size;
+  if (arg->IsString()) {
+    StringBytes s(arg);
+    string.assign((const char*) s.data(), s.length());
+    key = (const uint8_t*) string.data();
+    key_size = string.size();
+  } else if (node::Buffer::HasInstance(arg)) {
+    Local<Object> other = arg->ToObject();
+    key = (const uint8_t*) node::Buffer::Data(other);
+    key_size = node::Buffer::Length(other);
+  } else {
+    UNI_THROW_EXCEPTION(Exception::TypeError,
+                        "Key must be a string or a buffer.");
+    return Local<Value>();
+  }
+
+  if (key_size != width) {
+    UNI_THROW_EXCEPTION(Exception::RangeError,
+                        "Key size should be equal to the key width.");
+    return Local<Value>();
+  }
+
+  const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+  const size_t index = lower_bound_fixed(data, count, width, key);
+  if (exact && (index == count || memcmp(data + index * width, key, width))) {
+    return UNI_INTEGER_NEW(-1);
+  }
+  return UNI_INTEGER_NEW(index);
+}
 
-    while (head < tail) {
-      --tail;
-      uint8_t t = *head;
-      *head = *tail;
-      *tail = t;
-      ++head;
+// Sorts the buffer as packed keys of equal width, in place.
+struct SortFixedAction: UnaryAction<SortFixedAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    size_t count;
+    const size_t width = keyWidth(buffer, args, args_start, &count);
+    if (width == 0 || !writableBuffer(buffer, args)) {
+      return Local<Value>();
     }
 
+    sort_fixed((uint8_t*) node::Buffer::Data(buffer), count, width);
     return buffer;
   }
 };
 
+struct BinarySearchFixedAction: UnaryAction<BinarySearchFixedAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    return searchFixed(buffer, args, args_start, true);
+  }
+};
+
+struct LowerBoundAction: UnaryAction<LowerBoundAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    return searchFixed(buffer, args, args_start, false);
+  }
+};
+
 struct EqualsAction: BinaryAction<EqualsAction> {
   Local<Value> apply(Local<Object> buffer,
                      const uint8_t* data,
                      size_t size,
                      UNI_CONST_ARGUMENTS(args),
                      uint32_t args_start) {
-    return UNI_BOOLEAN_NEW(compare(buffer, data, size) == 0);
+    const uint8_t* data2 = (const uint8_t*) node::Buffer::Data(buffer);
+    return UNI_BOOLEAN_NEW(node::Buffer::Length(buffer) == size &&
+                           (data2 == data || mem_equal(data2, data, size)));
+  }
+};
+
+// Only the contents are hidden, a difference in length returns right away.
+struct TimingSafeEqualsAction: BinaryAction<TimingSafeEqualsAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     const uint8_t* data,
+                     size_t size,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    return UNI_BOOLEAN_NEW(
+        node::Buffer::Length(buffer) == size &&
+        mem_equal_constant_time((const uint8_t*) node::Buffer::Data(buffer),
+                                data,
+                                size));
   }
 };
 
+// Arguments: operand, then either the encoding of a string operand or the
+// targetStart, targetEnd, sourceStart and sourceEnd of Buffer#compare().
+// The target is the operand, the source is this buffer.
 struct CompareAction: BinaryAction<CompareAction> {
   Local<Value> apply(Local<Object> buffer,
                      const uint8_t* data,
                      size_t size,
                      UNI_CONST_ARGUMENTS(args),
                      uint32_t args_start) {
-    return UNI_INTEGER_NEW(compare(buffer, data, size));
+    const uint8_t* source = (const uint8_t*) node::Buffer::Data(buffer);
+    size_t source_size = node::Buffer::Length(buffer);
+
+    if (!args[args_start + 1]->IsString()) {
+      size_t start, end;
+      sliceRange(&start,
+                 &end,
+                 size,
+                 args[args_start + 1],
+                 args[args_start + 2]);
+      data += start;
+      size = end - start;
+      sliceRange(&start,
+                 &end,
+                 source_size,
+                 args[args_start + 3],
+                 args[args_start + 4]);
+      source += start;
+      source_size = end - start;
+    }
+
+    return UNI_INTEGER_NEW(compare(source, source_size, data, size));
+  }
+};
+
+// compare() of the first |n| bytes of both.
+struct ComparePrefixAction: BinaryAction<ComparePrefixAction> {
+  static const int kEncodingArgument = 2;
+
+  Local<Value> apply(Local<Object> buffer,
+                     const uint8_t* data,
+                     size_t size,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    if (!args[args_start + 1]->IsNumber()) {
+      UNI_THROW_EXCEPTION(Exception::TypeError, "Length should be a number.");
+      return Local<Value>();
+    }
+    if (args[args_start + 1]->Int32Value() < 0) {
+      UNI_THROW_EXCEPTION(Exception::RangeError,
+                          "Length should not be negative.");
+      return Local<Value>();
+    }
+
+    const size_t n = args[args_start + 1]->Int32Value();
+    return UNI_INTEGER_NEW(
+        compare((const uint8_t*) node::Buffer::Data(buffer),
+                std::min(n, (size_t) node::Buffer::Length(buffer)),
+                data,
+                std::min(n, size)));
+  }
+};
+
+struct StartsWithAction: BinaryAction<StartsWithAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     const uint8_t* data,
+                     size_t size,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    return UNI_BOOLEAN_NEW(
+        size <= node::Buffer::Length(buffer) &&
+        mem_equal((const uint8_t*) node::Buffer::Data(buffer), data, size));
+  }
+};
+
+struct EndsWithAction: BinaryAction<EndsWithAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     const uint8_t* data,
+                     size_t size,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    const size_t length = node::Buffer::Length(buffer);
+    const uint8_t* end = (const uint8_t*) node::Buffer::Data(buffer) + length;
+    return UNI_BOOLEAN_NEW(size <= length && mem_equal(end - size, data, size));
   }
 };
 
 struct IndexOfAction: BinaryAction<IndexOfAction> {
+  static const int kEncodingArgument = 2;
+  static const bool kOptionalOffset = true;
+
   Local<Value> apply(Local<Object> buffer,
                      const uint8_t* data2,
                      size_t size2,
@@ -326,179 +973,2881 @@ struct IndexOfAction: BinaryAction<IndexOfAction> {
     const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
     const size_t size = node::Buffer::Length(buffer);
 
-    int32_t start = args[args_start + 1]->Int32Value();
-
-    if (start < 0)
-      start = size - std::min<size_t>(size, -start);
-    else if (static_cast<size_t>(start) > size)
-      start = size;
+    const size_t start = clampOffset(args[args_start + 1]->Int32Value(), size);
 
-    const uint8_t* p = boyermoore_search(
-      data + start, size - start, data2, size2);
+    const uint8_t* p = search(data + start, size - start, data2, size2);
 
     const ptrdiff_t offset = p ? (p - data) : -1;
     return UNI_INTEGER_NEW(offset);
   }
 };
 
-static char toHexTable[] = "0123456789abcdef";
+// Arguments: byte, string or buffer, [start], [encoding]. Counts the bytes
+// or the non-overlapping occurrences of the needle from |start| onwards.
+struct CountAction: UnaryAction<CountAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+    const size_t size = node::Buffer::Length(buffer);
+    const size_t start = clampOffset(args[args_start + 1]->Int32Value(), size);
 
-// CHECKME is this cache efficient?
-static signed char fromHexTable[] = {
-    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,0,1,2,3,4,5,6,7,8,9,-1,-1,-1,-1,-1,-1,-1,
-    10,11,12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-    10,11,12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
-};
+    Local<Value> operand = args[args_start];
+    if (operand->IsInt32()) {
+      return UNI_INTEGER_NEW(
+          count_byte(data + start, size - start, operand->Int32Value()));
+    }
 
-inline Local<Value> decodeHex(const uint8_t* const data,
-                              const size_t size,
-                              UNI_CONST_ARGUMENTS(args),
-                              uint32_t args_start) {
-  if (size & 1) {
-    UNI_THROW_EXCEPTION(Exception::Error,
-                        "Odd string length, this is not hexadecimal data.");
-    return Local<Value>();
-  }
+    if (operand->IsString()) {
+      // Like for indexOf(), the start can be left out.
+      Local<Value> encoding_arg = args[args_start + 1]->IsString() ?
+          args[args_start + 1] : args[args_start + 2];
+      StringEncoding encoding;
+      if (!stringEncoding(&encoding, encoding_arg, args)) {
+        return Local<Value>();
+      }
+      StringBytes s(operand, encoding);
+      return count(data + start, size - start, s.data(), s.length(), args);
+    }
 
-  if (size == 0) {
-    return UNI_STRING_EMPTY();
+    if (node::Buffer::HasInstance(operand)) {
+      return count(data + start,
+                   size - start,
+                   (const uint8_t*) node::Buffer::Data(operand),
+                   node::Buffer::Length(operand),
+                   args);
+    }
+
+    UNI_THROW_EXCEPTION(Exception::TypeError,
+                        "Second argument should be either a string, a buffer "
+                        "or an integer.");
+    return Local<Value>();
   }
 
-  Local<Object> buffer = UNI_BUFFER_NEW(size / 2);
-  uint8_t *src = (uint8_t *) data;
-  uint8_t *dst = (uint8_t *) (const uint8_t*) node::Buffer::Data(buffer);
+  Local<Value> count(const uint8_t* data,
+                     size_t size,
+                     const uint8_t* needle,
+                     size_t needle_size,
+                     UNI_CONST_ARGUMENTS(args)) {
+    if (needle_size == 0) {
+      UNI_THROW_EXCEPTION(Exception::Error, "Needle should not be empty.");
+      return Local<Value>();
+    }
+    if (needle_size == 1) {
+      return UNI_INTEGER_NEW(count_byte(data, size, needle[0]));
+    }
 
-  for (size_t i = 0; i < size; i += 2) {
-    int a = fromHexTable[*src++];
-    int b = fromHexTable[*src++];
+    search_pattern pattern;
+    search_prepare(&pattern, needle, needle_size);
 
-    if (a == -1 || b == -1) {
-      UNI_THROW_EXCEPTION(Exception::Error, "This is not hexadecimal data.");
-      return Local<Value>();
+    size_t n = 0;
+    const uint8_t* end = data + size;
+    const uint8_t* p;
+    while ((p = search_pattern_first(&pattern, data, end - data)) != NULL) {
+      data = p + needle_size;
+      ++n;
     }
 
-    *dst++ = b | (a << 4);
+    search_release(&pattern);
+    return UNI_INTEGER_NEW(n);
   }
+};
 
-  return buffer;
-}
+// Arguments: byte set (string or buffer), [start], [encoding]. Returns the
+// index of the first byte from |start| onwards that is in the set, or isn't
+// for FindFirstNotOfAction, or -1.
+template <bool negate>
+struct FindFirstOfActionBase: BinaryAction<FindFirstOfActionBase<negate> > {
+  static const int kEncodingArgument = 2;
+  static const bool kOptionalOffset = true;
 
-struct FromHexAction: UnaryAction<FromHexAction> {
   Local<Value> apply(Local<Object> buffer,
+                     const uint8_t* bytes,
+                     size_t bytes_size,
                      UNI_CONST_ARGUMENTS(args),
                      uint32_t args_start) {
     const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
-    size_t length = node::Buffer::Length(buffer);
-    return decodeHex(data, length, args, args_start);
+    const size_t size = node::Buffer::Length(buffer);
+    const size_t start = clampOffset(args[args_start + 1]->Int32Value(), size);
+
+    size_t index;
+    if (bytes_size == 1 && !negate) {
+      const uint8_t* p = search_byte(data + start, size - start, bytes[0]);
+      index = p ? (size_t) (p - data) : size;
+    } else {
+      byte_set set;
+      byte_set_init(&set, bytes, bytes_size);
+      index = start + find_first_of(data + start, size - start, &set, negate);
+    }
+
+    return UNI_INTEGER_NEW(index < size ? (ptrdiff_t) index : -1);
   }
 };
 
-struct ToHexAction: UnaryAction<ToHexAction> {
+typedef FindFirstOfActionBase<false> FindFirstOfAction;
+typedef FindFirstOfActionBase<true> FindFirstNotOfAction;
+
+// Arguments: Uint32Array with room for 256 counts. Adds the number of times
+// that every byte value occurs to it.
+struct HistogramAction: UnaryAction<HistogramAction> {
   Local<Value> apply(Local<Object> buffer,
                      UNI_CONST_ARGUMENTS(args),
                      uint32_t args_start) {
-    const size_t size = node::Buffer::Length(buffer);
-    const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
-
-    if (size == 0) {
-      return UNI_STRING_EMPTY();
+    size_t length;
+    uint32_t* counts = static_cast<uint32_t*>(
+        typedArrayData(args[args_start], kUint32Array, &length));
+    if (counts == NULL || length < 256) {
+      UNI_THROW_EXCEPTION(Exception::TypeError,
+                          "Counts should be a Uint32Array of 256 elements.");
+      return Local<Value>();
     }
 
-    std::string s(size * 2, 0);
-    for (size_t i = 0; i < size; ++i) {
-      const uint8_t c = (uint8_t) data[i];
-      s[i * 2] = toHexTable[c >> 4];
-      s[i * 2 + 1] = toHexTable[c & 15];
-    }
+    byte_histogram((const uint8_t*) node::Buffer::Data(buffer),
+                   node::Buffer::Length(buffer),
+                   counts);
+    return args[args_start];
+  }
+};
 
-    return UNI_STRING_NEW(s.c_str(), s.size());
+struct IsAsciiAction: UnaryAction<IsAsciiAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    return UNI_BOOLEAN_NEW(is_ascii((const uint8_t*) node::Buffer::Data(buffer),
+                                    node::Buffer::Length(buffer)));
   }
 };
 
+struct IsUtf8Action: UnaryAction<IsUtf8Action> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    return UNI_BOOLEAN_NEW(is_utf8((const uint8_t*) node::Buffer::Data(buffer),
+                                   node::Buffer::Length(buffer)));
+  }
+};
+
+struct LastIndexOfAction: BinaryAction<LastIndexOfAction> {
+  static const int kEncodingArgument = 2;
+  static const bool kOptionalOffset = true;
+
+  Local<Value> apply(Local<Object> buffer,
+                     const uint8_t* data2,
+                     size_t size2,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+    const size_t size = node::Buffer::Length(buffer);
+
+    // Only matches that lie completely before |end| are considered. A
+    // string in its place is the encoding.
+    Local<Value> end_arg = args[args_start + 1];
+    const size_t end = end_arg->IsUndefined() || end_arg->IsString() ?
+        size : clampOffset(end_arg->Int32Value(), size);
+
+    const uint8_t* p = search_last(data, end, data2, size2);
+
+    const ptrdiff_t offset = p ? (p - data) : -1;
+    return UNI_INTEGER_NEW(offset);
+  }
+};
+
+// Arguments: delimiter, Int32Array, limit. Stores the fields between the
+// delimiters as offset, length pairs and returns the number of fields, that
+// is more than fit in the array if it's too small. Stops after |limit|
+// fields, like String#split().
+struct SplitOffsetsAction: BinaryAction<SplitOffsetsAction> {
+  static const int kEncodingArgument = 3;
+
+  Local<Value> apply(Local<Object> buffer,
+                     const uint8_t* delimiter,
+                     size_t delimiter_size,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    if (delimiter_size == 0) {
+      UNI_THROW_EXCEPTION(Exception::Error, "Delimiter should not be empty.");
+      return Local<Value>();
+    }
+
+    size_t capacity;
+    int32_t* offsets = static_cast<int32_t*>(
+        typedArrayData(args[args_start + 1], kInt32Array, &capacity));
+    if (offsets == NULL) {
+      UNI_THROW_EXCEPTION(Exception::TypeError,
+                          "Offsets should be an Int32Array.");
+      return Local<Value>();
+    }
+    capacity /= 2;
+
+    const size_t limit = args[args_start + 2]->IsUndefined() ?
+        SIZE_MAX : args[args_start + 2]->Uint32Value();
+
+    const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+    const size_t size = node::Buffer::Length(buffer);
+
+    search_pattern pattern;
+    search_prepare(&pattern, delimiter, delimiter_size);
+
+    size_t count = 0;
+    size_t start = 0;
+    while (count < limit) {
+      const uint8_t* p = search_pattern_first(&pattern,
+                                              data + start,
+                                              size - start);
+      const size_t end = p ? (size_t) (p - data) : size;
+      if (count < capacity) {
+        offsets[2 * count] = (int32_t) start;
+        offsets[2 * count + 1] = (int32_t) (end - start);
+      }
+      ++count;
+      if (p == NULL) {
+        break;
+      }
+      start = end + delimiter_size;
+    }
+
+    search_release(&pattern);
+    return UNI_INTEGER_NEW(count);
+  }
+};
+
+// Returns the buffer that a bitwise action writes to: |buffer| itself
+// unless args[index] is another buffer. Throws and returns an empty handle
+// if args[index] is something else, too small or read-only.
+Local<Object> bitwiseTarget(Local<Object> buffer,
+                            UNI_CONST_ARGUMENTS(args),
+                            uint32_t index) {
+  if (args[index]->IsUndefined()) {
+    return writableBuffer(buffer, args) ? buffer : Local<Object>();
+  }
+
+  if (!node::Buffer::HasInstance(args[index])) {
+    UNI_THROW_EXCEPTION(Exception::TypeError,
+                        "Target should be a buffer object.");
+    return Local<Object>();
+  }
+
+  Local<Object> target = args[index]->ToObject();
+  if (node::Buffer::Length(target) < node::Buffer::Length(buffer)) {
+    UNI_THROW_EXCEPTION(Exception::RangeError,
+                        "Target buffer is too small.");
+    return Local<Object>();
+  }
+
+  return writableBuffer(target, args) ? target : Local<Object>();
+}
+
+template <class Op>
+struct BitwiseAction: BinaryAction<BitwiseAction<Op> > {
+  static const int kEncodingArgument = 0;
+
+  Local<Value> apply(Local<Object> buffer,
+                     const uint8_t* data,
+                     size_t size,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    if (size == 0) {
+      UNI_THROW_EXCEPTION(Exception::Error, "Operand should not be empty.");
+      return Local<Value>();
+    }
+
+    Local<Object> target = bitwiseTarget(buffer, args, args_start + 1);
+    if (target.IsEmpty()) {
+      return Local<Value>();
+    }
+
+    bitwise<Op>((uint8_t*) node::Buffer::Data(target),
+                (const uint8_t*) node::Buffer::Data(buffer),
+                node::Buffer::Length(buffer),
+                data,
+                size);
+    return target;
+  }
+};
+
+typedef BitwiseAction<bitwise_and> AndAction;
+typedef BitwiseAction<bitwise_or> OrAction;
+typedef BitwiseAction<bitwise_xor> XorAction;
+
+struct NotAction: UnaryAction<NotAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    Local<Object> target = bitwiseTarget(buffer, args, args_start);
+    if (target.IsEmpty()) {
+      return Local<Value>();
+    }
+
+    static const uint8_t ones = 0xff;
+    bitwise<bitwise_xor>((uint8_t*) node::Buffer::Data(target),
+                         (const uint8_t*) node::Buffer::Data(buffer),
+                         node::Buffer::Length(buffer),
+                         &ones,
+                         1);
+    return target;
+  }
+};
+
+// Owns the characters of a hex string that was handed to V8 without copying.
+class ExternalHexString: public ExternalOneByteResource {
+ public:
+  ExternalHexString(char* data, size_t size): data_(data), size_(size) {}
+  ~ExternalHexString() { delete[] data_; }
+  const char* data() const { return data_; }
+  size_t length() const { return size_; }
+
+ private:
+  char* data_;
+  size_t size_;
+};
+
+// Short strings are cheaper to copy into the V8 heap than to track as
+// external strings.
+#define HEX_EXTERNAL_MIN_SIZE 1024
+
+// Hands |s| to V8 without copying, the string takes ownership of it.
+// Returns an empty handle if the string is too long.
+Local<String> externalHexString(char* s, size_t size) {
+  ExternalHexString* resource = new ExternalHexString(s, size);
+
+  // V8 only takes ownership of the resource when it creates the string.
+  Local<String> string = UNI_STRING_NEW_EXTERNAL(resource);
+  if (string.IsEmpty()) {
+    delete resource;
+  }
+  return string;
+}
+
+inline Local<Value> decodeHex(const uint8_t* const data,
+                              const size_t size,
+                              UNI_CONST_ARGUMENTS(args),
+                              uint32_t args_start) {
+  if (size & 1) {
+    UNI_THROW_EXCEPTION(Exception::Error,
+                        "Odd string length, this is not hexadecimal data.");
+    return Local<Value>();
+  }
+
+  if (size == 0) {
+    return UNI_STRING_EMPTY();
+  }
+
+  Local<Object> buffer = UNI_BUFFER_NEW(size / 2);
+  uint8_t* dst = (uint8_t*) node::Buffer::Data(buffer);
+
+  if (!hex_decode(dst, data, size)) {
+    UNI_THROW_EXCEPTION(Exception::Error, "This is not hexadecimal data.");
+    return Local<Value>();
+  }
+
+  return buffer;
+}
+
+struct FromHexAction: UnaryAction<FromHexAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+    size_t length = node::Buffer::Length(buffer);
+    return decodeHex(data, length, args, args_start);
+  }
+};
+
+inline Local<Value> encodeHex(const uint8_t* const data,
+                              const size_t size,
+                              UNI_CONST_ARGUMENTS(args)) {
+  if (size == 0) {
+    return UNI_STRING_EMPTY();
+  }
+
+  if (size * 2 < HEX_EXTERNAL_MIN_SIZE) {
+    char s[HEX_EXTERNAL_MIN_SIZE];
+    hex_encode(s, data, size);
+    return UNI_STRING_NEW_ONE_BYTE((const uint8_t*) s, size * 2);
+  }
+
+  char* s = new char[stats_allocation(size * 2)];
+  hex_encode(s, data, size);
+  return externalHexString(s, size * 2);
+}
+
+struct ToHexAction: UnaryAction<ToHexAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+    const size_t size = node::Buffer::Length(buffer);
+    return encodeHex(data, size, args);
+  }
+};
+
+// Returns the destination buffer of an "into" action and stores the start
+// offset in |offset|. Throws and returns an empty handle if the destination
+// is not a buffer, can't hold |size| bytes or is read-only.
+Local<Object> intoTarget(size_t size,
+                         size_t* offset,
+                         UNI_CONST_ARGUMENTS(args),
+                         uint32_t args_start) {
+  if (!node::Buffer::HasInstance(args[args_start])) {
+    UNI_THROW_EXCEPTION(Exception::TypeError,
+                        "Destination should be a buffer object.");
+    return Local<Object>();
+  }
+
+  Local<Object> target = args[args_start]->ToObject();
+  const size_t length = node::Buffer::Length(target);
+  *offset = clampOffset(args[args_start + 1]->Int32Value(), length);
+
+  if (size > length - *offset) {
+    UNI_THROW_EXCEPTION(Exception::RangeError,
+                        "Destination buffer is too small.");
+    return Local<Object>();
+  }
+
+  return writableBuffer(target, args) ? target : Local<Object>();
+}
+
+struct FromHexIntoAction: UnaryAction<FromHexIntoAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+    const size_t size = node::Buffer::Length(buffer);
+
+    if (size & 1) {
+      UNI_THROW_EXCEPTION(Exception::Error,
+                          "Odd string length, this is not hexadecimal data.");
+      return Local<Value>();
+    }
+
+    size_t offset;
+    Local<Object> target = intoTarget(size / 2, &offset, args, args_start);
+    if (target.IsEmpty()) {
+      return Local<Value>();
+    }
+
+    uint8_t* dst = (uint8_t*) node::Buffer::Data(target) + offset;
+    if (!hex_decode(dst, data, size)) {
+      UNI_THROW_EXCEPTION(Exception::Error, "This is not hexadecimal data.");
+      return Local<Value>();
+    }
+
+    return UNI_INTEGER_NEW(size / 2);
+  }
+};
+
+struct ToHexIntoAction: UnaryAction<ToHexIntoAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+    const size_t size = node::Buffer::Length(buffer);
+
+    size_t offset;
+    Local<Object> target = intoTarget(size * 2, &offset, args, args_start);
+    if (target.IsEmpty()) {
+      return Local<Value>();
+    }
+
+    hex_encode(node::Buffer::Data(target) + offset, data, size);
+    return UNI_INTEGER_NEW(size * 2);
+  }
+};
+
+//
+// base64 and base32
+//
+// The codecs plug into the same four actions as hex: encode to a string,
+// decode to a new buffer and the "into" variants that write to a buffer
+// that the caller supplies. The options object is { url, padding }, base32
+// ignores url. Padding is on by default, except for the URL safe alphabet.
+struct CodecOptions {
+  bool url;
+  bool padding;
+};
+
+CodecOptions codecOptions(Local<Value> value, UNI_CONST_ARGUMENTS(args)) {
+  CodecOptions options = { false, true };
+  if (value->IsObject()) {
+    Local<Object> object = value->ToObject();
+    Local<Value> padding = object->Get(UNI_STRING_NEW("padding", 7));
+    options.url = object->Get(UNI_STRING_NEW("url", 3))->BooleanValue();
+    options.padding =
+        padding->IsUndefined() ? !options.url : padding->BooleanValue();
+  }
+  return options;
+}
+
+struct Base64Codec {
+  static size_t encodedSize(size_t size, const CodecOptions& options) {
+    return base64_encoded_size(size, options.padding);
+  }
+
+  static void encode(char* dst,
+                     const uint8_t* src,
+                     size_t size,
+                     const CodecOptions& options) {
+    base64_encode(dst, src, size, options.url, options.padding);
+  }
+
+  static bool unpad(const uint8_t* src, size_t* size) {
+    return base64_unpad(src, size);
+  }
+
+  static size_t decodedSize(size_t size) {
+    return base64_decoded_size(size);
+  }
+
+  static bool decode(uint8_t* dst,
+                     const uint8_t* src,
+                     size_t size,
+                     const CodecOptions& options) {
+    return base64_decode(dst, src, size, options.url);
+  }
+
+  static const char* error() {
+    return "This is not base64 data.";
+  }
+};
+
+struct Base32Codec {
+  static size_t encodedSize(size_t size, const CodecOptions& options) {
+    return base32_encoded_size(size, options.padding);
+  }
+
+  static void encode(char* dst,
+                     const uint8_t* src,
+                     size_t size,
+                     const CodecOptions& options) {
+    base32_encode(dst, src, size, options.padding);
+  }
+
+  static bool unpad(const uint8_t* src, size_t* size) {
+    return base32_unpad(src, size);
+  }
+
+  static size_t decodedSize(size_t size) {
+    return base32_decoded_size(size);
+  }
+
+  static bool decode(uint8_t* dst,
+                     const uint8_t* src,
+                     size_t size,
+                     const CodecOptions& options) {
+    return base32_decode(dst, src, size);
+  }
+
+  static const char* error() {
+    return "This is not base32 data.";
+  }
+};
+
+// Arguments: options.
+template <class Codec>
+struct EncodeAction: UnaryAction<EncodeAction<Codec> > {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    const CodecOptions options = codecOptions(args[args_start], args);
+    const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+    const size_t size = node::Buffer::Length(buffer);
+    const size_t length = Codec::encodedSize(size, options);
+
+    if (length == 0) {
+      return UNI_STRING_EMPTY();
+    }
+
+    // Like encodeHex(), the output is ASCII too.
+    if (length < HEX_EXTERNAL_MIN_SIZE) {
+      char s[HEX_EXTERNAL_MIN_SIZE];
+      Codec::encode(s, data, size, options);
+      return UNI_STRING_NEW_ONE_BYTE((const uint8_t*) s, length);
+    }
+
+    char* s = new char[stats_allocation(length)];
+    Codec::encode(s, data, size, options);
+    return externalHexString(s, length);
+  }
+};
+
+// Arguments: options.
+template <class Codec>
+struct DecodeAction: UnaryAction<DecodeAction<Codec> > {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    const CodecOptions options = codecOptions(args[args_start], args);
+    const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+    size_t size = node::Buffer::Length(buffer);
+
+    if (!Codec::unpad(data, &size)) {
+      UNI_THROW_EXCEPTION(Exception::Error, Codec::error());
+      return Local<Value>();
+    }
+
+    Local<Object> result = UNI_BUFFER_NEW(Codec::decodedSize(size));
+    uint8_t* dst = (uint8_t*) node::Buffer::Data(result);
+    if (!Codec::decode(dst, data, size, options)) {
+      UNI_THROW_EXCEPTION(Exception::Error, Codec::error());
+      return Local<Value>();
+    }
+
+    return result;
+  }
+};
+
+// Arguments: destination buffer, offset, options. Returns the number of
+// characters written.
+template <class Codec>
+struct EncodeIntoAction: UnaryAction<EncodeIntoAction<Codec> > {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    const CodecOptions options = codecOptions(args[args_start + 2], args);
+    const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+    const size_t size = node::Buffer::Length(buffer);
+    const size_t length = Codec::encodedSize(size, options);
+
+    size_t offset;
+    Local<Object> target = intoTarget(length, &offset, args, args_start);
+    if (target.IsEmpty()) {
+      return Local<Value>();
+    }
+
+    Codec::encode(node::Buffer::Data(target) + offset, data, size, options);
+    return UNI_INTEGER_NEW(length);
+  }
+};
+
+// Arguments: destination buffer, offset, options. Returns the number of
+// bytes written.
+template <class Codec>
+struct DecodeIntoAction: UnaryAction<DecodeIntoAction<Codec> > {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    const CodecOptions options = codecOptions(args[args_start + 2], args);
+    const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+    size_t size = node::Buffer::Length(buffer);
+
+    if (!Codec::unpad(data, &size)) {
+      UNI_THROW_EXCEPTION(Exception::Error, Codec::error());
+      return Local<Value>();
+    }
+
+    const size_t length = Codec::decodedSize(size);
+    size_t offset;
+    Local<Object> target = intoTarget(length, &offset, args, args_start);
+    if (target.IsEmpty()) {
+      return Local<Value>();
+    }
+
+    uint8_t* dst = (uint8_t*) node::Buffer::Data(target) + offset;
+    if (!Codec::decode(dst, data, size, options)) {
+      UNI_THROW_EXCEPTION(Exception::Error, Codec::error());
+      return Local<Value>();
+    }
+
+    return UNI_INTEGER_NEW(length);
+  }
+};
+
+typedef EncodeAction<Base64Codec> ToBase64Action;
+typedef DecodeAction<Base64Codec> FromBase64Action;
+typedef EncodeIntoAction<Base64Codec> ToBase64IntoAction;
+typedef DecodeIntoAction<Base64Codec> FromBase64IntoAction;
+typedef EncodeAction<Base32Codec> ToBase32Action;
+typedef DecodeAction<Base32Codec> FromBase32Action;
+typedef EncodeIntoAction<Base32Codec> ToBase32IntoAction;
+typedef DecodeIntoAction<Base32Codec> FromBase32IntoAction;
+
+// Stores the combined size in bytes of the strings and buffers in
+// args[start...] in |size| and the UTF-8 length of every string in
+// |lengths|, so concatCopy() doesn't have to measure them again. Throws and
+// returns false if there is an argument that is neither.
+bool concatSize(size_t* size,
+                std::vector<size_t>* lengths,
+                UNI_CONST_ARGUMENTS(args),
+                int start) {
+  *size = 0;
+  for (int index = start, length = args.Length(); index < length; ++index) {
+    Local<Value> arg = args[index];
+    if (arg->IsString()) {
+      // Utf8Length() because we need the length in bytes, not characters
+      lengths->push_back(arg->ToString()->Utf8Length());
+      *size += lengths->back();
+    }
+    else if (node::Buffer::HasInstance(arg)) {
+      *size += node::Buffer::Length(arg->ToObject());
+    }
+    else {
+      char errmsg[256];
+      snprintf(errmsg,
+               sizeof(errmsg),
+               "Argument #%lu is neither a string nor a buffer object.",
+               static_cast<unsigned long>(index));
+      UNI_THROW_EXCEPTION(Exception::TypeError, errmsg);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Copies the arguments that concatSize() has checked to |s|. Strings are
+// encoded in place.
+void concatCopy(uint8_t* s,
+                const std::vector<size_t>& lengths,
+                UNI_CONST_ARGUMENTS(args),
+                int start) {
+  size_t n = 0;
+  for (int index = start, length = args.Length(); index < length; ++index) {
+    Local<Value> arg = args[index];
+    if (arg->IsString()) {
+      s += stringWrite(s, lengths[n++], arg->ToString(), kUtf8);
+    }
+    else {
+      Local<Object> b = arg->ToObject();
+      const uint8_t* data = (const uint8_t*) node::Buffer::Data(b);
+      size_t length = node::Buffer::Length(b);
+      memcpy(s, data, length);
+      s += length;
+    }
+  }
+}
+
+struct ConcatIntoAction: UnaryAction<ConcatIntoAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    const size_t length = node::Buffer::Length(buffer);
+    const size_t offset = clampOffset(args[args_start]->Int32Value(), length);
+
+    size_t size;
+    std::vector<size_t> lengths;
+    if (!concatSize(&size, &lengths, args, args_start + 1)) {
+      return Local<Value>();
+    }
+
+    if (size > length - offset) {
+      UNI_THROW_EXCEPTION(Exception::RangeError,
+                          "Destination buffer is too small.");
+      return Local<Value>();
+    }
+    if (!writableBuffer(buffer, args)) {
+      return Local<Value>();
+    }
+
+    uint8_t* data = (uint8_t*) node::Buffer::Data(buffer);
+    concatCopy(data + offset, lengths, args, args_start + 1);
+    return UNI_INTEGER_NEW(size);
+  }
+};
+
+//
+// thread pool
+//
+// An action that runs on the libuv thread pool. The objects that it reads
+// from or writes to are pinned with persistent handles until the callback
+// has been called, the first one is the receiver of the callback.
+//
+// Big inputs are split into ranges of about |parallel_range_size| bytes that
+// are handed out round-robin to up to |parallel_workers| pool threads, so
+// every worker streams through the buffer in cache-sized steps and all of
+// them finish at about the same time.
+size_t parallel_workers = 1;
+size_t parallel_range_size = 256 * 1024;
+
+class AsyncWork {
+ public:
+  virtual ~AsyncWork() {
+    for (size_t i = 0; i < pinned_.size(); ++i) {
+      UNI_PERSISTENT_DISPOSE(*pinned_[i]);
+      delete pinned_[i];
+    }
+    UNI_PERSISTENT_DISPOSE(callback_);
+  }
+
+  // Queues |work| and takes ownership of it.
+  static void Queue(AsyncWork* work, Local<v8::Function> callback) {
+    UNI_PERSISTENT_RESET(work->callback_, callback);
+
+    // Ranges must start at a multiple of the granularity.
+    const size_t granularity = work->Granularity();
+    size_t range = parallel_range_size + granularity - 1;
+    range -= range % granularity;
+
+    size_t workers = 1;
+    if (parallel_workers > 1 && work->size_ > range) {
+      workers = std::min(parallel_workers, (work->size_ + range - 1) / range);
+    }
+    work->range_ = workers > 1 ? range : std::max<size_t>(work->size_, 1);
+
+    work->workers_.resize(workers);
+    for (size_t i = 0; i < workers; ++i) {
+      Worker& worker = work->workers_[i];
+      worker.req.data = &worker;
+      worker.work = work;
+      worker.index = i;
+      worker.error = NULL;
+    }
+    work->pending_ = workers;
+    for (size_t i = 0; i < workers; ++i) {
+      uv_queue_work(uv_default_loop(), &work->workers_[i].req, Work, After);
+    }
+  }
+
+ protected:
+  // |size| is the number of bytes of input that Run() is called for.
+  explicit AsyncWork(size_t size): size_(size) {}
+
+  void pin(Local<Object> object) {
+    v8::Persistent<v8::Object>* handle = new v8::Persistent<v8::Object>;
+    UNI_PERSISTENT_RESET(*handle, object);
+    pinned_.push_back(handle);
+  }
+
+  Local<Object> pinned(size_t index) const {
+    return UNI_PERSISTENT_LOCAL(v8::Object, *pinned_[index]);
+  }
+
+  // Ranges start at a multiple of this, e.g. 2 for hex digits.
+  virtual size_t Granularity() const {
+    return 1;
+  }
+
+  // Processes the input from |start| to |end|. Runs on the thread pool,
+  // concurrently with other ranges, and must not touch V8. Returns an error
+  // message or NULL.
+  virtual const char* Run(size_t start, size_t end) = 0;
+
+  // Runs on the main thread when all ranges are done and returns the value
+  // that is passed to the callback. May set |error_| instead.
+  virtual Local<Value> Result() = 0;
+
+  const size_t size_;
+  std::string error_;
+
+ private:
+  struct Worker {
+    uv_work_t req;
+    AsyncWork* work;
+    size_t index;
+    const char* error;
+  };
+
+  static void Work(uv_work_t* req) {
+    Worker* worker = static_cast<Worker*>(req->data);
+    AsyncWork* work = worker->work;
+    const size_t stride = work->range_ * work->workers_.size();
+
+    for (size_t start = worker->index * work->range_;
+         start < work->size_;
+         start += stride) {
+      const size_t end = std::min(start + work->range_, work->size_);
+      worker->error = work->Run(start, end);
+      if (worker->error) {
+        break;
+      }
+    }
+  }
+
+  static UNI_AFTER_WORK_CALLBACK(After) {
+    UNI_CURRENT_HANDLESCOPE();
+
+    AsyncWork* work = static_cast<Worker*>(req->data)->work;
+    if (--work->pending_ > 0) {
+      return;
+    }
+
+    for (size_t i = 0; i < work->workers_.size(); ++i) {
+      if (work->workers_[i].error) {
+        work->error_ = work->workers_[i].error;
+        break;
+      }
+    }
+
+    Local<Value> result;
+    if (work->error_.empty()) {
+      result = work->Result();
+    }
+
+    // The third argument tells how the work was done.
+    Local<Value> argv[3];
+    int argc = 3;
+    if (work->error_.empty()) {
+      argv[0] = UNI_CURRENT_NULL();
+      argv[1] = result;
+      argv[2] = UNI_CURRENT_STRING_NEW(work->workers_.size() > 1 ?
+                                       "parallel" : "thread");
+    } else {
+      argv[0] = Exception::Error(UNI_CURRENT_STRING_NEW(work->error_.c_str()));
+      argc = 1;
+    }
+
+    Local<Object> receiver = work->pinned(0);
+    Local<v8::Function> callback =
+        UNI_PERSISTENT_LOCAL(v8::Function, work->callback_);
+    delete work;
+
+    UNI_MAKE_CALLBACK(receiver, callback, argc, argv);
+  }
+
+  v8::Persistent<v8::Function> callback_;
+  std::vector<v8::Persistent<v8::Object>*> pinned_;
+  std::vector<Worker> workers_;
+  size_t pending_;
+  size_t range_;
+};
+
+// Returns the callback of an async action, the last argument. Throws and
+// returns an empty handle if it's not a function.
+Local<v8::Function> asyncCallback(UNI_CONST_ARGUMENTS(args)) {
+  Local<Value> callback = args[args.Length() > 0 ? args.Length() - 1 : 0];
+  if (!callback->IsFunction()) {
+    UNI_THROW_EXCEPTION(Exception::TypeError,
+                        "Callback should be a function.");
+    return Local<v8::Function>();
+  }
+  return callback.As<v8::Function>();
+}
+
+// Every range also searches the needle size - 1 bytes past its end so that
+// matches that straddle two ranges are found. The earliest match wins, the
+// ranges after it are skipped.
+class IndexOfWork: public AsyncWork {
+ public:
+  IndexOfWork(Local<Object> buffer,
+              const uint8_t* needle,
+              size_t needle_size,
+              size_t start)
+      : AsyncWork(node::Buffer::Length(buffer) - start),
+        data_((const uint8_t*) node::Buffer::Data(buffer) + start),
+        start_(start),
+        found_(SIZE_MAX) {
+    pin(buffer);
+    search_prepare(&pattern_, needle, needle_size);
+    uv_mutex_init(&mutex_);
+  }
+
+  ~IndexOfWork() {
+    search_release(&pattern_);
+    uv_mutex_destroy(&mutex_);
+  }
+
+ private:
+  const char* Run(size_t start, size_t end) {
+    if (pattern_.needle_size == 0 || found() <= start) {
+      return NULL;
+    }
+
+    end = std::min(end + pattern_.needle_size - 1, size_);
+    const uint8_t* p = search_pattern_first(&pattern_,
+                                            data_ + start,
+                                            end - start);
+    if (p) {
+      const size_t offset = p - data_;
+      uv_mutex_lock(&mutex_);
+      found_ = std::min(found_, offset);
+      uv_mutex_unlock(&mutex_);
+    }
+    return NULL;
+  }
+
+  Local<Value> Result() {
+    if (found_ == SIZE_MAX) {
+      return UNI_CURRENT_INTEGER_NEW(-1);
+    }
+    return UNI_CURRENT_INTEGER_NEW(start_ + found_);
+  }
+
+  size_t found() {
+    uv_mutex_lock(&mutex_);
+    const size_t offset = found_;
+    uv_mutex_unlock(&mutex_);
+    return offset;
+  }
+
+  const uint8_t* data_;
+  size_t start_;
+  search_pattern pattern_;  // a copy, the argument may be a temporary string
+  uv_mutex_t mutex_;
+  size_t found_;
+};
+
+class FromHexWork: public AsyncWork {
+ public:
+  FromHexWork(Local<Object> buffer, Local<Object> output)
+      : AsyncWork(node::Buffer::Length(buffer)),
+        src_((const uint8_t*) node::Buffer::Data(buffer)),
+        dst_((uint8_t*) node::Buffer::Data(output)) {
+    pin(buffer);
+    pin(output);
+  }
+
+ private:
+  size_t Granularity() const {
+    return 2;
+  }
+
+  const char* Run(size_t start, size_t end) {
+    if (!hex_decode(dst_ + start / 2, src_ + start, end - start)) {
+      return "This is not hexadecimal data.";
+    }
+    return NULL;
+  }
+
+  Local<Value> Result() {
+    if (size_ == 0) {
+      return UNI_CURRENT_STRING_NEW("");  // like fromHex()
+    }
+    return pinned(1);
+  }
+
+  const uint8_t* src_;
+  uint8_t* dst_;
+};
+
+class ToHexWork: public AsyncWork {
+ public:
+  explicit ToHexWork(Local<Object> buffer)
+      : AsyncWork(node::Buffer::Length(buffer)),
+        data_((const uint8_t*) node::Buffer::Data(buffer)),
+        s_(new char[stats_allocation(node::Buffer::Length(buffer) * 2)]) {
+    pin(buffer);
+  }
+
+  ~ToHexWork() {
+    delete[] s_;
+  }
+
+ private:
+  const char* Run(size_t start, size_t end) {
+    hex_encode(s_ + start * 2, data_ + start, end - start);
+    return NULL;
+  }
+
+  Local<Value> Result() {
+    if (size_ == 0) {
+      return UNI_CURRENT_STRING_NEW("");
+    }
+
+    char* s = s_;
+    s_ = NULL;
+    Local<String> string = externalHexString(s, size_ * 2);
+    if (string.IsEmpty()) {
+      error_ = "String is too long.";
+    }
+    return string;
+  }
+
+  const uint8_t* data_;
+  char* s_;
+};
+
+// Ranges start at a whole repetition of the pattern unless the pattern is
+// as long as the buffer.
+class FillWork: public AsyncWork {
+ public:
+  FillWork(Local<Object> buffer,
+           uint8_t* data,
+           size_t size,
+           const void* pattern,
+           size_t pattern_size)
+      : AsyncWork(size),
+        data_(data),
+        pattern_((const char*) pattern, pattern_size) {
+    pin(buffer);
+  }
+
+ private:
+  size_t Granularity() const {
+    return pattern_.size() > 0 && pattern_.size() < size_ ?
+        pattern_.size() : 1;
+  }
+
+  const char* Run(size_t start, size_t end) {
+    if (pattern_.size() >= size_) {
+      memcpy(data_ + start, pattern_.data() + start, end - start);
+    } else {
+      // Non-temporal stores or not depends on the whole fill, not on the
+      // size of the range.
+      fill_pattern_ex(data_ + start,
+                      end - start,
+                      pattern_.data(),
+                      pattern_.size(),
+                      size_ >= FILL_NONTEMPORAL_THRESHOLD);
+    }
+    return NULL;
+  }
+
+  Local<Value> Result() {
+    return pinned(0);
+  }
+
+  uint8_t* data_;
+  std::string pattern_;
+};
+
+// Like FillWork, ranges start at a whole repetition of the operand. A
+// target that partially overlaps the buffer is done in one go, the result
+// would depend on the order of the ranges otherwise.
+template <class Op>
+class BitwiseWork: public AsyncWork {
+ public:
+  BitwiseWork(Local<Object> buffer,
+              Local<Object> target,
+              const uint8_t* operand,
+              size_t operand_size)
+      : AsyncWork(node::Buffer::Length(buffer)),
+        src_((const uint8_t*) node::Buffer::Data(buffer)),
+        dst_((uint8_t*) node::Buffer::Data(target)),
+        operand_((const char*) operand, operand_size) {
+    pin(target);
+    pin(buffer);
+  }
+
+ private:
+  size_t Granularity() const {
+    if (src_ != dst_ && src_ < dst_ + size_ && dst_ < src_ + size_) {
+      return size_;
+    }
+    return operand_.size() < size_ ? operand_.size() : 1;
+  }
+
+  const char* Run(size_t start, size_t end) {
+    const uint8_t* operand = (const uint8_t*) operand_.data();
+    if (operand_.size() >= size_) {
+      bitwise<Op>(dst_ + start, src_ + start, end - start,
+                  operand + start, end - start);
+    } else {
+      bitwise<Op>(dst_ + start, src_ + start, end - start,
+                  operand, operand_.size());
+    }
+    return NULL;
+  }
+
+  Local<Value> Result() {
+    return pinned(0);
+  }
+
+  const uint8_t* src_;
+  uint8_t* dst_;
+  std::string operand_;
+};
+
+struct IndexOfAsyncAction: BinaryAction<IndexOfAsyncAction> {
+  static const int kEncodingArgument = 2;
+  static const bool kOptionalOffset = true;
+
+  Local<Value> apply(Local<Object> buffer,
+                     const uint8_t* data2,
+                     size_t size2,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    Local<v8::Function> callback = asyncCallback(args);
+    if (callback.IsEmpty()) {
+      return Local<Value>();
+    }
+
+    // The start offset is optional.
+    const size_t size = node::Buffer::Length(buffer);
+    size_t start = 0;
+    if (!args[args_start + 1]->IsFunction()) {
+      start = clampOffset(args[args_start + 1]->Int32Value(), size);
+    }
+
+    AsyncWork::Queue(new IndexOfWork(buffer, data2, size2, start), callback);
+    return Local<Value>();
+  }
+};
+
+struct FromHexAsyncAction: UnaryAction<FromHexAsyncAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    Local<v8::Function> callback = asyncCallback(args);
+    if (callback.IsEmpty()) {
+      return Local<Value>();
+    }
+
+    const size_t size = node::Buffer::Length(buffer);
+    if (size & 1) {
+      UNI_THROW_EXCEPTION(Exception::Error,
+                          "Odd string length, this is not hexadecimal data.");
+      return Local<Value>();
+    }
+
+    Local<Object> output = UNI_BUFFER_NEW(size / 2);
+    AsyncWork::Queue(new FromHexWork(buffer, output), callback);
+    return Local<Value>();
+  }
+};
+
+struct ToHexAsyncAction: UnaryAction<ToHexAsyncAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    Local<v8::Function> callback = asyncCallback(args);
+    if (callback.IsEmpty()) {
+      return Local<Value>();
+    }
+
+    AsyncWork::Queue(new ToHexWork(buffer), callback);
+    return Local<Value>();
+  }
+};
+
+template <class Op>
+struct BitwiseAsyncAction: BinaryAction<BitwiseAsyncAction<Op> > {
+  static const int kEncodingArgument = 0;
+
+  Local<Value> apply(Local<Object> buffer,
+                     const uint8_t* data,
+                     size_t size,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    Local<v8::Function> callback = asyncCallback(args);
+    if (callback.IsEmpty()) {
+      return Local<Value>();
+    }
+
+    if (size == 0) {
+      UNI_THROW_EXCEPTION(Exception::Error, "Operand should not be empty.");
+      return Local<Value>();
+    }
+
+    // The target is optional.
+    Local<Object> target = buffer;
+    if (!args[args_start + 1]->IsFunction()) {
+      target = bitwiseTarget(buffer, args, args_start + 1);
+      if (target.IsEmpty()) {
+        return Local<Value>();
+      }
+    }
+
+    AsyncWork::Queue(new BitwiseWork<Op>(buffer, target, data, size),
+                     callback);
+    return Local<Value>();
+  }
+};
+
+typedef BitwiseAsyncAction<bitwise_and> AndAsyncAction;
+typedef BitwiseAsyncAction<bitwise_or> OrAsyncAction;
+typedef BitwiseAsyncAction<bitwise_xor> XorAsyncAction;
+
+struct FillAsyncAction: UnaryAction<FillAsyncAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    Local<v8::Function> callback = asyncCallback(args);
+    if (callback.IsEmpty()) {
+      return Local<Value>();
+    }
+
+    size_t start, end;
+    StringEncoding encoding;
+    if (!writableBuffer(buffer, args) ||
+        !fillRange(&start, &end, &encoding, buffer, args, args_start + 1)) {
+      return Local<Value>();
+    }
+    uint8_t* data = (uint8_t*) node::Buffer::Data(buffer) + start;
+    const size_t length = end - start;
+
+    FillWork* work;
+    if (args[args_start]->IsInt32()) {
+      const char c = (char) args[args_start]->Int32Value();
+      work = new FillWork(buffer, data, length, &c, 1);
+    } else if (args[args_start]->IsString()) {
+      StringBytes s(args[args_start], encoding);
+      work = new FillWork(buffer, data, length, s.data(), s.length());
+    } else if (node::Buffer::HasInstance(args[args_start])) {
+      Local<Object> other = args[args_start]->ToObject();
+      work = new FillWork(buffer,
+                          data,
+                          length,
+                          node::Buffer::Data(other),
+                          node::Buffer::Length(other));
+    } else {
+      UNI_THROW_EXCEPTION(Exception::TypeError,
+                          "Second argument should be either a string, a "
+                          "buffer or an integer.");
+      return Local<Value>();
+    }
+
+    AsyncWork::Queue(work, callback);
+    return Local<Value>();
+  }
+};
+
+//
+// batch actions
+//
+// The items of a batch action: an array of buffers, or one packed buffer
+// and a Uint32Array with the offset of every item plus the end of the last
+// one. Running a whole batch in one call saves the per-call overhead, which
+// dominates for small items like 40 byte keys.
+class BatchItems {
+ public:
+  BatchItems(): bytes_(0) {}
+
+  // Throws and returns false if the arguments are no good.
+  bool init(Local<Value> items,
+            Local<Value> offsets,
+            UNI_CONST_ARGUMENTS(args));
+
+  size_t size() const {
+    return items_.size();
+  }
+
+  const uint8_t* data(size_t index) const {
+    return items_[index].data;
+  }
+
+  size_t length(size_t index) const {
+    return items_[index].size;
+  }
+
+  // The total length of the items.
+  size_t bytes() const {
+    return bytes_;
+  }
+
+ private:
+  struct Item {
+    const uint8_t* data;
+    size_t size;
+  };
+
+  std::vector<Item> items_;
+  size_t bytes_;
+};
+
+bool BatchItems::init(Local<Value> items,
+                      Local<Value> offsets,
+                      UNI_CONST_ARGUMENTS(args)) {
+  if (items->IsArray()) {
+    Local<v8::Array> array = Local<v8::Array>::Cast(items);
+    items_.resize(array->Length());
+    for (uint32_t index = 0; index < items_.size(); ++index) {
+      Local<Value> item = array->Get(index);
+      if (!node::Buffer::HasInstance(item)) {
+        char errmsg[256];
+        snprintf(errmsg,
+                 sizeof(errmsg),
+                 "Item #%lu is not a buffer object.",
+                 static_cast<unsigned long>(index));
+        UNI_THROW_EXCEPTION(Exception::TypeError, errmsg);
+        return false;
+      }
+      Local<Object> buffer = item->ToObject();
+      items_[index].data = (const uint8_t*) node::Buffer::Data(buffer);
+      items_[index].size = node::Buffer::Length(buffer);
+      bytes_ += items_[index].size;
+    }
+    return true;
+  }
+
+  size_t count;
+  const uint32_t* ends = static_cast<const uint32_t*>(
+      typedArrayData(offsets, kUint32Array, &count));
+  if (!node::Buffer::HasInstance(items) || ends == NULL) {
+    UNI_THROW_EXCEPTION(Exception::TypeError,
+                        "Items should be an array of buffers or a buffer "
+                        "and a Uint32Array of offsets.");
+    return false;
+  }
+
+  Local<Object> buffer = items->ToObject();
+  const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+  const size_t length = node::Buffer::Length(buffer);
+
+  items_.resize(count > 0 ? count - 1 : 0);
+  for (size_t index = 0; index < items_.size(); ++index) {
+    if (ends[index] > ends[index + 1] || ends[index + 1] > length) {
+      UNI_THROW_EXCEPTION(Exception::RangeError,
+                          "Offsets should be ascending and within the "
+                          "buffer.");
+      return false;
+    }
+    items_[index].data = data + ends[index];
+    items_[index].size = ends[index + 1] - ends[index];
+    bytes_ += items_[index].size;
+  }
+  return true;
+}
+
+// Copies the operand of a batch action, a string or a buffer, to |operand|.
+// Throws and returns false if it's something else.
+bool batchOperand(std::string* operand,
+                  Local<Value> value,
+                  UNI_CONST_ARGUMENTS(args)) {
+  if (value->IsString()) {
+    Local<String> s = value->ToString();
+    operand->resize(stringLength(s, kUtf8));
+    stringWrite((uint8_t*) &(*operand)[0], operand->size(), s, kUtf8);
+    return true;
+  }
+
+  if (node::Buffer::HasInstance(value)) {
+    Local<Object> buffer = value->ToObject();
+    operand->assign(node::Buffer::Data(buffer), node::Buffer::Length(buffer));
+    return true;
+  }
+
+  UNI_THROW_EXCEPTION(Exception::TypeError,
+                      "Operand must be a string or a buffer.");
+  return false;
+}
+
+// Returns the elements of the typed array that the results of a batch
+// action are stored in. Throws and returns NULL if it's not a typed array
+// of |type| with at least |size| elements.
+void* batchResults(Local<Value> value,
+                   TypedArrayType type,
+                   size_t size,
+                   UNI_CONST_ARGUMENTS(args)) {
+  size_t length;
+  void* results = typedArrayData(value, type, &length);
+  if (results == NULL || length < size) {
+    UNI_THROW_EXCEPTION(Exception::TypeError,
+                        "Results array is of the wrong type or too small.");
+    return NULL;
+  }
+  return results;
+}
+
+//
+// stats
+//
+// Calls, bytes, allocations and latency per native function. See Stats.h.
+// The callbacks below record themselves with a StatsScope.
+
+// What the stats count as the bytes that a call processed: the size of the
+// buffer that it was called on.
+size_t statsBytes(UNI_CONST_ARGUMENTS(args)) {
+  if (node::Buffer::HasInstance(args.This())) {
+    return node::Buffer::Length(args.This());
+  }
+  if (node::Buffer::HasInstance(args[0])) {
+    return node::Buffer::Length(args[0]);
+  }
+  return 0;
+}
+
+class StatsScope {
+ public:
+  StatsScope(int action, UNI_CONST_ARGUMENTS(args))
+      : action_(action),
+        bytes_(0),
+        previous_(NULL),
+        stats_(NULL),
+        start_(0) {
+    if ((stats_enabled || STATS_PROBES) && action >= 0) {
+      bytes_ = statsBytes(args);
+      STATS_PROBE(start, stats_names[action], bytes_);
+      previous_ = stats_current;
+      stats_ = stats_begin(action, bytes_);
+      if (stats_ != NULL) {
+        start_ = uv_hrtime();
+      }
+    }
+  }
+
+  ~StatsScope() {
+    if (stats_ != NULL) {
+      stats_end(stats_, previous_, uv_hrtime() - start_);
+    }
+    if (STATS_PROBES && action_ >= 0) {
+      STATS_PROBE(done, stats_names[action_], bytes_);
+    }
+  }
+
+  // Replaces what statsBytes() counted, for calls that don't work on the
+  // buffer that they're called with or only know the size later on. The
+  // start probe has fired with the old count by then.
+  void set_bytes(size_t bytes) {
+    if (stats_ != NULL) {
+      stats_->bytes += bytes - bytes_;
+    }
+    bytes_ = bytes;
+  }
+
+ private:
+  const int action_;
+  size_t bytes_;
+  action_stats* previous_;
+  action_stats* stats_;
+  uint64_t start_;
+};
+
+//
+// compiled search patterns
+//
+class Pattern: public node::ObjectWrap {
+ public:
+  static void Initialize();
+  static UNI_FUNCTION_CALLBACK(New);
+  static UNI_FUNCTION_CALLBACK(IndexOf);
+  static UNI_FUNCTION_CALLBACK(LastIndexOf);
+  static UNI_FUNCTION_CALLBACK(Count);
+
+  static v8::Persistent<v8::Function> constructor;
+
+ private:
+  Pattern(const uint8_t* needle, size_t size) {
+    search_prepare(&pattern_, needle, size);
+  }
+
+  ~Pattern() {
+    search_release(&pattern_);
+  }
+
+  search_pattern pattern_;
+};
+
+v8::Persistent<v8::Function> Pattern::constructor;
+
+void Pattern::Initialize() {
+  Local<v8::FunctionTemplate> t = UNI_FUNCTION_TEMPLATE_NEW(New);
+  t->InstanceTemplate()->SetInternalFieldCount(1);
+  NODE_SET_PROTOTYPE_METHOD(t, "indexOf", IndexOf);
+  NODE_SET_PROTOTYPE_METHOD(t, "lastIndexOf", LastIndexOf);
+  NODE_SET_PROTOTYPE_METHOD(t, "count", Count);
+  UNI_PERSISTENT_RESET(constructor, t->GetFunction());
+}
+
+UNI_FUNCTION_CALLBACK(Pattern::New) {
+  UNI_HANDLESCOPE();
+
+  if (!args.IsConstructCall()) {
+    UNI_THROW_AND_RETURN(Exception::TypeError,
+                         "Use buffertools.compilePattern() to create a "
+                         "pattern.");
+  }
+
+  Pattern* pattern;
+  if (args[0]->IsString()) {
+    StringBytes s(args[0]);
+    pattern = new Pattern(s.data(), s.length());
+  }
+  else if (node::Buffer::HasInstance(args[0])) {
+    Local<Object> needle = args[0]->ToObject();
+    pattern = new Pattern((const uint8_t*) node::Buffer::Data(needle),
+                          node::Buffer::Length(needle));
+  }
+  else {
+    UNI_THROW_AND_RETURN(Exception::TypeError,
+                         "Argument should be a string or a buffer.");
+  }
+
+  pattern->Wrap(args.This());
+  UNI_RETURN(args.This());
+}
+
+const int PatternIndexOfStats = stats_register("Pattern.indexOf");
+UNI_FUNCTION_CALLBACK(Pattern::IndexOf) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(PatternIndexOfStats, args);
+
+  if (!node::Buffer::HasInstance(args[0])) {
+    UNI_THROW_AND_RETURN(Exception::TypeError,
+                         "Argument should be a buffer object.");
+  }
+
+  Pattern* pattern = ObjectWrap::Unwrap<Pattern>(args.Holder());
+  Local<Object> buffer = args[0]->ToObject();
+  const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+  const size_t size = node::Buffer::Length(buffer);
+  const size_t start = clampOffset(args[1]->Int32Value(), size);
+
+  const uint8_t* p = search_pattern_first(
+    &pattern->pattern_, data + start, size - start);
+
+  const ptrdiff_t offset = p ? (p - data) : -1;
+  UNI_RETURN(UNI_INTEGER_NEW(offset));
+}
+
+const int PatternLastIndexOfStats = stats_register("Pattern.lastIndexOf");
+UNI_FUNCTION_CALLBACK(Pattern::LastIndexOf) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(PatternLastIndexOfStats, args);
+
+  if (!node::Buffer::HasInstance(args[0])) {
+    UNI_THROW_AND_RETURN(Exception::TypeError,
+                         "Argument should be a buffer object.");
+  }
+
+  Pattern* pattern = ObjectWrap::Unwrap<Pattern>(args.Holder());
+  Local<Object> buffer = args[0]->ToObject();
+  const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+  const size_t size = node::Buffer::Length(buffer);
+  const size_t end = args[1]->IsUndefined() ?
+      size : clampOffset(args[1]->Int32Value(), size);
+
+  const uint8_t* p = search_pattern_last(&pattern->pattern_, data, end);
+
+  const ptrdiff_t offset = p ? (p - data) : -1;
+  UNI_RETURN(UNI_INTEGER_NEW(offset));
+}
+
+const int PatternCountStats = stats_register("Pattern.count");
+
+// Counts non-overlapping occurrences, like String#split() would find them.
+UNI_FUNCTION_CALLBACK(Pattern::Count) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(PatternCountStats, args);
+
+  if (!node::Buffer::HasInstance(args[0])) {
+    UNI_THROW_AND_RETURN(Exception::TypeError,
+                         "Argument should be a buffer object.");
+  }
+
+  Pattern* pattern = ObjectWrap::Unwrap<Pattern>(args.Holder());
+  Local<Object> buffer = args[0]->ToObject();
+  const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+  const uint8_t* end = data + node::Buffer::Length(buffer);
+  const uint8_t* p = data + clampOffset(args[1]->Int32Value(), end - data);
+
+  int32_t count = 0;
+  while ((p = search_pattern_first(&pattern->pattern_, p, end - p))) {
+    p += pattern->pattern_.needle_size;
+    ++count;
+  }
+
+  UNI_RETURN(UNI_INTEGER_NEW(count));
+}
+
+//
+// incremental hashing
+//
+class Hasher: public node::ObjectWrap {
+ public:
+  static void Initialize();
+  static UNI_FUNCTION_CALLBACK(New);
+  static UNI_FUNCTION_CALLBACK(Update);
+  static UNI_FUNCTION_CALLBACK(Digest);
+
+  static v8::Persistent<v8::Function> constructor;
+
+ private:
+  xxh64_state state_;
+};
+
+v8::Persistent<v8::Function> Hasher::constructor;
+
+void Hasher::Initialize() {
+  Local<v8::FunctionTemplate> t = UNI_FUNCTION_TEMPLATE_NEW(New);
+  t->InstanceTemplate()->SetInternalFieldCount(1);
+  NODE_SET_PROTOTYPE_METHOD(t, "update", Update);
+  NODE_SET_PROTOTYPE_METHOD(t, "digest", Digest);
+  UNI_PERSISTENT_RESET(constructor, t->GetFunction());
+}
+
+UNI_FUNCTION_CALLBACK(Hasher::New) {
+  UNI_HANDLESCOPE();
+
+  if (!args.IsConstructCall()) {
+    UNI_THROW_AND_RETURN(Exception::TypeError,
+                         "Use buffertools.createHash64() to create a hash.");
+  }
+
+  Hasher* hash = new Hasher;
+  xxh64_init(&hash->state_, hashSeed(args[0]));
+  hash->Wrap(args.This());
+  UNI_RETURN(args.This());
+}
+
+const int HasherUpdateStats = stats_register("Hash64.update");
+
+// Adds a buffer or a string to the hash. Returns the hash object so calls
+// can be chained.
+UNI_FUNCTION_CALLBACK(Hasher::Update) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(HasherUpdateStats, args);
+
+  Hasher* hash = ObjectWrap::Unwrap<Hasher>(args.Holder());
+  if (args[0]->IsString()) {
+    StringBytes s(args[0]);
+    xxh64_update(&hash->state_, s.data(), s.length());
+  } else if (node::Buffer::HasInstance(args[0])) {
+    Local<Object> buffer = args[0]->ToObject();
+    xxh64_update(&hash->state_,
+                 (const uint8_t*) node::Buffer::Data(buffer),
+                 node::Buffer::Length(buffer));
+  } else {
+    UNI_THROW_AND_RETURN(Exception::TypeError,
+                         "Argument should be a string or a buffer.");
+  }
+
+  UNI_RETURN(args.Holder());
+}
+
+const int HasherDigestStats = stats_register("Hash64.digest");
+
+// Returns the hash of everything so far. More data can be added after.
+UNI_FUNCTION_CALLBACK(Hasher::Digest) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(HasherDigestStats, args);
+  Hasher* hash = ObjectWrap::Unwrap<Hasher>(args.Holder());
+  UNI_RETURN(hashBuffer(xxh64_digest(&hash->state_), args));
+}
+
+//
+// multi-pattern matching
+//
+class Matcher: public node::ObjectWrap {
+ public:
+  static void Initialize();
+  static UNI_FUNCTION_CALLBACK(New);
+  static UNI_FUNCTION_CALLBACK(Match);
+
+  static v8::Persistent<v8::Function> constructor;
+
+ private:
+  // Writes (offset, needle index) pairs until the output array is full.
+  struct Collector {
+    int32_t* out;
+    size_t size;
+    size_t count;
+    size_t start;
+
+    void operator()(size_t offset, int32_t id) {
+      if (count < size) {
+        out[count * 2] = start + offset;
+        out[count * 2 + 1] = id;
+      }
+      ++count;
+    }
+  };
+
+  AhoCorasick automaton_;
+};
+
+v8::Persistent<v8::Function> Matcher::constructor;
+
+void Matcher::Initialize() {
+  Local<v8::FunctionTemplate> t = UNI_FUNCTION_TEMPLATE_NEW(New);
+  t->InstanceTemplate()->SetInternalFieldCount(1);
+  NODE_SET_PROTOTYPE_METHOD(t, "match", Match);
+  UNI_PERSISTENT_RESET(constructor, t->GetFunction());
+}
+
+UNI_FUNCTION_CALLBACK(Matcher::New) {
+  UNI_HANDLESCOPE();
+
+  if (!args.IsConstructCall()) {
+    UNI_THROW_AND_RETURN(Exception::TypeError,
+                         "Use buffertools.createMatcher() to create a "
+                         "matcher.");
+  }
+
+  if (!args[0]->IsArray()) {
+    UNI_THROW_AND_RETURN(Exception::TypeError,
+                         "Argument should be an array of strings or buffers.");
+  }
+
+  Local<v8::Array> needles = Local<v8::Array>::Cast(args[0]);
+  Matcher* matcher = new Matcher;
+
+  const uint32_t length = needles->Length();
+  for (uint32_t index = 0; index < length; ++index) {
+    Local<Value> needle = needles->Get(index);
+    if (needle->IsString()) {
+      StringBytes s(needle);
+      matcher->automaton_.add(s.data(), s.length());
+    }
+    else if (node::Buffer::HasInstance(needle)) {
+      Local<Object> b = needle->ToObject();
+      matcher->automaton_.add((const uint8_t*) node::Buffer::Data(b),
+                              node::Buffer::Length(b));
+    }
+    else {
+      delete matcher;
+      char errmsg[256];
+      snprintf(errmsg,
+               sizeof(errmsg),
+               "Needle #%lu is neither a string nor a buffer object.",
+               static_cast<unsigned long>(index));
+      UNI_THROW_AND_RETURN(Exception::TypeError, errmsg);
+    }
+  }
+
+  matcher->automaton_.build();
+  matcher->Wrap(args.This());
+  UNI_RETURN(args.This());
+}
+
+const int MatcherMatchStats = stats_register("Matcher.match");
+
+// Returns the total number of matches, which is more than what fits in the
+// output array when it's too small.
+UNI_FUNCTION_CALLBACK(Matcher::Match) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(MatcherMatchStats, args);
+
+  if (!node::Buffer::HasInstance(args[0])) {
+    UNI_THROW_AND_RETURN(Exception::TypeError,
+                         "First argument should be a buffer object.");
+  }
+
+  Collector collector;
+  collector.out = static_cast<int32_t*>(
+      typedArrayData(args[1], kInt32Array, &collector.size));
+  if (collector.out == NULL) {
+    UNI_THROW_AND_RETURN(Exception::TypeError,
+                         "Second argument should be an Int32Array.");
+  }
+
+  Matcher* matcher = ObjectWrap::Unwrap<Matcher>(args.Holder());
+  Local<Object> buffer = args[0]->ToObject();
+  const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+  const size_t size = node::Buffer::Length(buffer);
+
+  collector.size /= 2;
+  collector.count = 0;
+  collector.start = clampOffset(args[2]->Int32Value(), size);
+
+  matcher->automaton_.scan(data + collector.start,
+                           size - collector.start,
+                           collector);
+
+  UNI_RETURN(UNI_INTEGER_NEW(collector.count));
+}
+
+//
+// incremental hex decoding
+//
+// Decodes hex data that arrives in pieces of any length. An odd digit at
+// the end of a piece is carried over to the next one.
+class HexDecoder: public node::ObjectWrap {
+ public:
+  static void Initialize();
+  static UNI_FUNCTION_CALLBACK(New);
+  static UNI_FUNCTION_CALLBACK(Decode);
+  static UNI_FUNCTION_CALLBACK(End);
+
+  static v8::Persistent<v8::Function> constructor;
+
+ private:
+  HexDecoder(): pending_(0), has_pending_(false) {}
+
+  bool decode(uint8_t* dst, const uint8_t* data, size_t size);
+
+  uint8_t pending_;
+  bool has_pending_;
+};
+
+v8::Persistent<v8::Function> HexDecoder::constructor;
+
+void HexDecoder::Initialize() {
+  Local<v8::FunctionTemplate> t = UNI_FUNCTION_TEMPLATE_NEW(New);
+  t->InstanceTemplate()->SetInternalFieldCount(1);
+  NODE_SET_PROTOTYPE_METHOD(t, "decode", Decode);
+  NODE_SET_PROTOTYPE_METHOD(t, "end", End);
+  UNI_PERSISTENT_RESET(constructor, t->GetFunction());
+}
+
+UNI_FUNCTION_CALLBACK(HexDecoder::New) {
+  UNI_HANDLESCOPE();
+
+  if (!args.IsConstructCall()) {
+    UNI_THROW_AND_RETURN(Exception::TypeError,
+                         "Use buffertools.createHexDecoder() to create a "
+                         "decoder.");
+  }
+
+  HexDecoder* decoder = new HexDecoder;
+  decoder->Wrap(args.This());
+  UNI_RETURN(args.This());
+}
+
+const int HexDecoderDecodeStats = stats_register("HexDecoder.decode");
+
+// Arguments: hex buffer, destination buffer, offset. Writes the bytes that
+// are complete to the destination and returns their number.
+UNI_FUNCTION_CALLBACK(HexDecoder::Decode) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(HexDecoderDecodeStats, args);
+
+  if (!node::Buffer::HasInstance(args[0])) {
+    UNI_THROW_AND_RETURN(Exception::TypeError,
+                         "Argument should be a buffer object.");
+  }
+
+  HexDecoder* decoder = ObjectWrap::Unwrap<HexDecoder>(args.Holder());
+  Local<Object> buffer = args[0]->ToObject();
+  const uint8_t* data = (const uint8_t*) node::Buffer::Data(buffer);
+  size_t size = node::Buffer::Length(buffer);
+
+  const size_t total = size + decoder->has_pending_;
+  size_t offset;
+  Local<Value> result;
+  Local<Object> target = intoTarget(total / 2, &offset, args, 1);
+  if (!target.IsEmpty()) {
+    uint8_t* dst = (uint8_t*) node::Buffer::Data(target) + offset;
+    if (decoder->decode(dst, data, size)) {
+      result = UNI_INTEGER_NEW(total / 2);
+    } else {
+      UNI_THROW_EXCEPTION(Exception::Error, "This is not hexadecimal data.");
+    }
+  }
+
+  UNI_RETURN(result);
+}
+
+// Decodes the pending digit and |data|, keeps an odd trailing digit for the
+// next call. Returns false and resets the decoder if there is a non-hex
+// digit.
+bool HexDecoder::decode(uint8_t* dst, const uint8_t* data, size_t size) {
+  bool valid = true;
+  if (has_pending_ && size > 0) {
+    const uint8_t pair[] = { pending_, data[0] };
+    valid = hex_decode(dst, pair, 2);
+    has_pending_ = false;
+    dst += 1;
+    data += 1;
+    size -= 1;
+  }
+
+  if (size & 1) {
+    pending_ = data[size - 1];
+    has_pending_ = true;
+    valid = valid && hex_values[pending_] >= 0;
+    size -= 1;
+  }
+
+  if (!valid || !hex_decode(dst, data, size)) {
+    has_pending_ = false;
+    return false;
+  }
+
+  return true;
+}
+
+const int HexDecoderEndStats = stats_register("HexDecoder.end");
+
+// Throws if a digit is left over, resets the decoder.
+UNI_FUNCTION_CALLBACK(HexDecoder::End) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(HexDecoderEndStats, args);
+
+  HexDecoder* decoder = ObjectWrap::Unwrap<HexDecoder>(args.Holder());
+  if (decoder->has_pending_) {
+    decoder->has_pending_ = false;
+    UNI_THROW_AND_RETURN(Exception::Error,
+                         "Odd string length, this is not hexadecimal data.");
+  }
+
+  UNI_RETURN(args.Holder());
+}
+
+//
+// segmented buffers
+//
+class BufferList: public node::ObjectWrap {
+ public:
+  static void Initialize();
+  static UNI_FUNCTION_CALLBACK(New);
+  static UNI_FUNCTION_CALLBACK(Push);
+  static UNI_FUNCTION_CALLBACK(IndexOf);
+  static UNI_FUNCTION_CALLBACK(Slice);
+  static UNI_FUNCTION_CALLBACK(Consume);
+  static UNI_FUNCTION_CALLBACK(Compare);
+  static UNI_FUNCTION_CALLBACK(Equals);
+
+  static v8::Persistent<v8::Function> constructor;
+
+ private:
+  static Local<Value> CompareRange(UNI_CONST_ARGUMENTS(args), bool equals);
+
+  // A reference to a buffer that was pushed, minus the bytes that have
+  // been consumed. |handle| keeps the memory alive.
+  struct Chunk {
+    v8::Persistent<v8::Object>* handle;
+    const uint8_t* data;
+    size_t size;
+  };
+
+  BufferList(): length_(0) {}
+
+  ~BufferList() {
+    while (!chunks_.empty()) {
+      pop();
+    }
+  }
+
+  void pop() {
+    UNI_PERSISTENT_DISPOSE(*chunks_.front().handle);
+    delete chunks_.front().handle;
+    chunks_.pop_front();
+  }
+
+  size_t copy(uint8_t* dst, size_t offset, size_t size) const;
+  ptrdiff_t indexOf(const search_pattern* pattern, size_t start) const;
+  int compare(size_t offset, const uint8_t* data, size_t size) const;
+  void consume(size_t size);
+
+  std::deque<Chunk> chunks_;
+  size_t length_;
+};
+
+v8::Persistent<v8::Function> BufferList::constructor;
+
+// Copies up to |size| bytes, starting at |offset|, to |dst|. Returns the
+// number of bytes copied.
+size_t BufferList::copy(uint8_t* dst, size_t offset, size_t size) const {
+  size_t copied = 0;
+  for (size_t i = 0; i < chunks_.size() && copied < size; ++i) {
+    const Chunk& chunk = chunks_[i];
+    if (offset >= chunk.size) {
+      offset -= chunk.size;
+      continue;
+    }
+    const size_t n = std::min(chunk.size - offset, size - copied);
+    memcpy(dst + copied, chunk.data + offset, n);
+    copied += n;
+    offset = 0;
+  }
+  return copied;
+}
+
+// Searches every chunk on its own and, at every chunk boundary, a window
+// made up of the needle size - 1 bytes on either side of it. The window
+// holds all matches that straddle the boundary, no matter how many small
+// chunks they span.
+ptrdiff_t BufferList::indexOf(const search_pattern* pattern,
+                              size_t start) const {
+  const size_t needle_size = pattern->needle_size;
+  if (needle_size == 0 || needle_size > length_ - start) {
+    return -1;
+  }
+
+  std::vector<uint8_t> window(2 * (needle_size - 1));
+  size_t offset = 0;  // of the current chunk
+
+  for (size_t i = 0; i < chunks_.size(); ++i) {
+    const Chunk& chunk = chunks_[i];
+    const size_t end = offset + chunk.size;
+    if (end <= start) {
+      offset = end;
+      continue;
+    }
+
+    if (offset > start && needle_size > 1) {
+      const size_t head = std::min(offset - start, needle_size - 1);
+      const size_t n = copy(&window[0], offset - head, head + needle_size - 1);
+      const uint8_t* p = search_pattern_first(pattern, &window[0], n);
+      if (p && (size_t) (p - &window[0]) < head) {
+        return offset - head + (p - &window[0]);
+      }
+    }
+
+    const size_t skip = start > offset ? start - offset : 0;
+    const uint8_t* p = search_pattern_first(pattern,
+                                            chunk.data + skip,
+                                            chunk.size - skip);
+    if (p) {
+      return offset + (p - chunk.data);
+    }
+
+    offset = end;
+  }
+
+  return -1;
+}
+
+// Like ::compare(), for the |size| bytes at |offset|. Ranges that extend
+// past the end are shorter and hence smaller.
+int BufferList::compare(size_t offset,
+                        const uint8_t* data,
+                        size_t size) const {
+  const size_t length = std::min(size, length_ - offset);
+  if (length != size) {
+    return -1;
+  }
+
+  for (size_t i = 0; i < chunks_.size() && size > 0; ++i) {
+    const Chunk& chunk = chunks_[i];
+    if (offset >= chunk.size) {
+      offset -= chunk.size;
+      continue;
+    }
+    const size_t n = std::min(chunk.size - offset, size);
+    const int r = mem_compare(chunk.data + offset, data, n);
+    if (r != 0) {
+      return r;
+    }
+    data += n;
+    size -= n;
+    offset = 0;
+  }
+
+  return 0;
+}
+
+void BufferList::consume(size_t size) {
+  length_ -= size;
+  while (size > 0) {
+    Chunk& chunk = chunks_.front();
+    if (size < chunk.size) {
+      chunk.data += size;
+      chunk.size -= size;
+      break;
+    }
+    size -= chunk.size;
+    pop();
+  }
+}
+
+void BufferList::Initialize() {
+  Local<v8::FunctionTemplate> t = UNI_FUNCTION_TEMPLATE_NEW(New);
+  t->InstanceTemplate()->SetInternalFieldCount(1);
+  NODE_SET_PROTOTYPE_METHOD(t, "push", Push);
+  NODE_SET_PROTOTYPE_METHOD(t, "indexOf", IndexOf);
+  NODE_SET_PROTOTYPE_METHOD(t, "slice", Slice);
+  NODE_SET_PROTOTYPE_METHOD(t, "consume", Consume);
+  NODE_SET_PROTOTYPE_METHOD(t, "compare", Compare);
+  NODE_SET_PROTOTYPE_METHOD(t, "equals", Equals);
+  UNI_PERSISTENT_RESET(constructor, t->GetFunction());
+}
+
+#define SET_LENGTH(object, length)                                            \
+  (object)->Set(UNI_STRING_NEW("length", 6), UNI_INTEGER_NEW(length))
+
+UNI_FUNCTION_CALLBACK(BufferList::New) {
+  UNI_HANDLESCOPE();
+
+  if (!args.IsConstructCall()) {
+    UNI_THROW_AND_RETURN(Exception::TypeError,
+                         "Use buffertools.createBufferList() to create a "
+                         "buffer list.");
+  }
+
+  BufferList* list = new BufferList;
+  list->Wrap(args.This());
+  SET_LENGTH(args.This(), 0);
+  UNI_RETURN(args.This());
+}
+
+const int BufferListPushStats = stats_register("BufferList.push");
+
+// Appends a reference to the buffer, the data is not copied. Returns the
+// new length.
+UNI_FUNCTION_CALLBACK(BufferList::Push) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(BufferListPushStats, args);
+
+  if (!node::Buffer::HasInstance(args[0])) {
+    UNI_THROW_AND_RETURN(Exception::TypeError,
+                         "Argument should be a buffer object.");
+  }
+
+  BufferList* list = ObjectWrap::Unwrap<BufferList>(args.Holder());
+  Local<Object> buffer = args[0]->ToObject();
+
+  Chunk chunk;
+  chunk.data = (const uint8_t*) node::Buffer::Data(buffer);
+  chunk.size = node::Buffer::Length(buffer);
+  if (chunk.size > 0) {
+    chunk.handle = new v8::Persistent<v8::Object>;
+    UNI_PERSISTENT_RESET(*chunk.handle, buffer);
+    list->chunks_.push_back(chunk);
+    list->length_ += chunk.size;
+  }
+
+  SET_LENGTH(args.Holder(), list->length_);
+  UNI_RETURN(UNI_INTEGER_NEW(list->length_));
+}
+
+const int BufferListIndexOfStats = stats_register("BufferList.indexOf");
+UNI_FUNCTION_CALLBACK(BufferList::IndexOf) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(BufferListIndexOfStats, args);
+
+  BufferList* list = ObjectWrap::Unwrap<BufferList>(args.Holder());
+  const size_t start = clampOffset(args[1]->Int32Value(), list->length_);
+
+  search_pattern pattern;
+  if (args[0]->IsString()) {
+    StringBytes s(args[0]);
+    search_prepare(&pattern, s.data(), s.length());
+  }
+  else if (node::Buffer::HasInstance(args[0])) {
+    Local<Object> needle = args[0]->ToObject();
+    search_prepare(&pattern,
+                   (const uint8_t*) node::Buffer::Data(needle),
+                   node::Buffer::Length(needle));
+  }
+  else {
+    UNI_THROW_AND_RETURN(Exception::TypeError,
+                         "Argument should be a string or a buffer.");
+  }
+
+  stats.set_bytes(list->length_ - start);
+  const ptrdiff_t offset = list->indexOf(&pattern, start);
+  search_release(&pattern);
+  UNI_RETURN(UNI_INTEGER_NEW(offset));
+}
+
+const int BufferListSliceStats = stats_register("BufferList.slice");
+
+// Copies the bytes in [start, end) to a new buffer.
+UNI_FUNCTION_CALLBACK(BufferList::Slice) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(BufferListSliceStats, args);
+
+  BufferList* list = ObjectWrap::Unwrap<BufferList>(args.Holder());
+  const size_t start = clampOffset(args[0]->Int32Value(), list->length_);
+  const size_t end = args[1]->IsUndefined() ?
+      list->length_ : clampOffset(args[1]->Int32Value(), list->length_);
+  const size_t size = end > start ? end - start : 0;
+  stats.set_bytes(size);
+
+  Local<Object> buffer = UNI_BUFFER_NEW(size);
+  list->copy((uint8_t*) node::Buffer::Data(buffer), start, size);
+  UNI_RETURN(buffer);
+}
+
+const int BufferListConsumeStats = stats_register("BufferList.consume");
+
+// Removes the first |size| bytes and returns them as a buffer. That's the
+// pushed buffer itself when it's consumed in one go, a copy otherwise.
+UNI_FUNCTION_CALLBACK(BufferList::Consume) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(BufferListConsumeStats, args);
+
+  BufferList* list = ObjectWrap::Unwrap<BufferList>(args.Holder());
+  const size_t size = args[0]->IsUndefined() ?
+      list->length_ : clampOffset(args[0]->Int32Value(), list->length_);
+  stats.set_bytes(size);
+
+  Local<Object> buffer;
+  if (size > 0 && size == list->chunks_.front().size) {
+    buffer = UNI_PERSISTENT_LOCAL(Object, *list->chunks_.front().handle);
+    if ((const uint8_t*) node::Buffer::Data(buffer) !=
+            list->chunks_.front().data ||
+        node::Buffer::Length(buffer) != size) {
+      buffer = Local<Object>();
+    }
+  }
+  if (buffer.IsEmpty()) {
+    buffer = UNI_BUFFER_NEW(size);
+    list->copy((uint8_t*) node::Buffer::Data(buffer), 0, size);
+  }
+
+  list->consume(size);
+  SET_LENGTH(args.Holder(), list->length_);
+  UNI_RETURN(buffer);
+}
+
+// Compares the bytes at args[1] with the string or buffer in args[0].
+// Returns the result of BufferList::compare() as a JS value, or a boolean
+// that says if they're equal.
+Local<Value> BufferList::CompareRange(UNI_CONST_ARGUMENTS(args), bool equals) {
+  BufferList* list = ObjectWrap::Unwrap<BufferList>(args.Holder());
+  const size_t offset = clampOffset(args[1]->Int32Value(), list->length_);
+
+  int r;
+  if (args[0]->IsString()) {
+    StringBytes s(args[0]);
+    r = list->compare(offset, s.data(), s.length());
+  }
+  else if (node::Buffer::HasInstance(args[0])) {
+    Local<Object> other = args[0]->ToObject();
+    r = list->compare(offset,
+                      (const uint8_t*) node::Buffer::Data(other),
+                      node::Buffer::Length(other));
+  }
+  else {
+    UNI_THROW_EXCEPTION(Exception::TypeError,
+                        "Argument should be a string or a buffer.");
+    return Local<Value>();
+  }
+
+  if (equals) {
+    return UNI_BOOLEAN_NEW(r == 0);
+  }
+  return UNI_INTEGER_NEW(r);
+}
+
+const int BufferListCompareStats = stats_register("BufferList.compare");
+UNI_FUNCTION_CALLBACK(BufferList::Compare) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(BufferListCompareStats, args);
+  UNI_RETURN(CompareRange(args, false));
+}
+
+const int BufferListEqualsStats = stats_register("BufferList.equals");
+UNI_FUNCTION_CALLBACK(BufferList::Equals) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(BufferListEqualsStats, args);
+  UNI_RETURN(CompareRange(args, true));
+}
+
+#undef SET_LENGTH
+
+//
+// memory mapped files
+//
+void FreeMappedFile(char* data, void* hint) {
+  mapped_file* file = static_cast<mapped_file*>(hint);
+  mapped_files.erase((const uint8_t*) file->base);
+  mapped_file_unmap(file);
+  delete file;
+}
+
+// Lets go of the file behind a buffer from mmap(), or a slice of one, and
+// empties the buffer. Returns false if it isn't mapped (anymore).
+struct MunmapAction: UnaryAction<MunmapAction> {
+  Local<Value> apply(Local<Object> buffer,
+                     UNI_CONST_ARGUMENTS(args),
+                     uint32_t args_start) {
+    MappedFiles::iterator it =
+        findMappedFile((const uint8_t*) node::Buffer::Data(buffer));
+    if (it == mapped_files.end()) {
+      return UNI_BOOLEAN_NEW(false);
+    }
+    UNI_BUFFER_DETACH(buffer);
+    mapped_file_release(it->second);
+    mapped_files.erase(it);
+    return UNI_BOOLEAN_NEW(true);
+  }
+};
+
+// Reads { advice: 'normal' | 'sequential' | 'random', willNeed: bool }.
+// Throws and returns false on an advice that we don't know.
+bool mappedFileOptions(mapped_file_advice* advice,
+                       bool* will_need,
+                       Local<Value> value,
+                       UNI_CONST_ARGUMENTS(args)) {
+  *advice = MAPPED_FILE_NORMAL;
+  *will_need = false;
+  if (!value->IsObject()) {
+    return true;
+  }
+
+  Local<Object> object = value->ToObject();
+  *will_need = object->Get(UNI_STRING_NEW("willNeed", 8))->BooleanValue();
+  Local<Value> name = object->Get(UNI_STRING_NEW("advice", 6));
+  if (name->IsUndefined()) {
+    return true;
+  }
+
+  StringBytes s(name);
+  const std::string advice_name((const char*) s.data(), s.length());
+  if (advice_name == "normal") {
+    return true;
+  }
+  if (advice_name == "sequential") {
+    *advice = MAPPED_FILE_SEQUENTIAL;
+    return true;
+  }
+  if (advice_name == "random") {
+    *advice = MAPPED_FILE_RANDOM;
+    return true;
+  }
+
+  UNI_THROW_EXCEPTION(Exception::TypeError,
+                      "Advice should be 'normal', 'sequential' or 'random'.");
+  return false;
+}
+
+// Reads a byte offset or length argument, which can be larger than 2^31.
+// Undefined leaves |*value| alone. Throws and returns false if it's negative.
+bool mappedFileRange(uint64_t* value,
+                     Local<Value> arg,
+                     UNI_CONST_ARGUMENTS(args)) {
+  if (arg->IsUndefined()) {
+    return true;
+  }
+  const int64_t n = arg->IntegerValue();
+  if (n < 0) {
+    UNI_THROW_EXCEPTION(Exception::RangeError,
+                        "Offset and length should not be negative.");
+    return false;
+  }
+  *value = (uint64_t) n;
+  return true;
+}
+
+// Reads the [offset], [length], [options] arguments of mmap(). The length
+// defaults to the rest of the file.
+bool mappedFileArguments(uint64_t* offset,
+                         uint64_t* length,
+                         mapped_file_advice* advice,
+                         bool* will_need,
+                         UNI_CONST_ARGUMENTS(args)) {
+  *offset = 0;
+  *length = (uint64_t) -1;
+
+  uint32_t index = 1;
+  if (args[index]->IsNumber() || args[index]->IsUndefined()) {
+    if (!mappedFileRange(offset, args[index++], args)) {
+      return false;
+    }
+    if (args[index]->IsNumber() || args[index]->IsUndefined()) {
+      if (!mappedFileRange(length, args[index++], args)) {
+        return false;
+      }
+    }
+  }
+
+  return mappedFileOptions(advice, will_need, args[index], args);
+}
+
+// Maps the range and wraps it in a buffer. Throws and returns an empty
+// handle if that fails.
+Local<Value> mapFile(const std::string& path,
+                     uint64_t offset,
+                     uint64_t length,
+                     mapped_file_advice advice,
+                     bool will_need,
+                     UNI_CONST_ARGUMENTS(args)) {
+  mapped_file* file = new mapped_file;
+  const char* syscall;
+  const int err = mapped_file_map(file,
+                                  path.c_str(),
+                                  offset,
+                                  length,
+                                  advice,
+                                  will_need,
+                                  &syscall);
+  if (err != 0) {
+    delete file;
+    UNI_THROW_ERRNO(err, syscall, path.c_str());
+    return Local<Value>();
+  }
+
+  if (file->length == 0) {
+    delete file;
+    return UNI_BUFFER_NEW(0);
+  }
+
+  if (file->length > node::Buffer::kMaxLength) {
+    mapped_file_unmap(file);
+    delete file;
+    UNI_THROW_EXCEPTION(Exception::RangeError,
+                        "Range is too large for a buffer, map it in parts.");
+    return Local<Value>();
+  }
+
+  mapped_files[(const uint8_t*) file->base] = file;
+  return UNI_BUFFER_NEW_EXTERNAL((char*) file->data,
+                                 file->length,
+                                 FreeMappedFile,
+                                 file);
+}
+
+//
+// V8 function callbacks
 //
-// V8 function callbacks
-//
 #define V(name)                                                               \
+  const int name ## Stats = stats_register(#name);                            \
   UNI_FUNCTION_CALLBACK(name) {                                               \
     UNI_HANDLESCOPE();                                                        \
+    StatsScope stats(name ## Stats, args);                                    \
     UNI_RETURN(name ## Action()(args));                                       \
   }
+V(And)
+V(AndAsync)
+V(BinarySearchFixed)
 V(Clear)
 V(Compare)
+V(ComparePrefix)
+V(ConcatInto)
+V(Count)
+V(Crc32c)
+V(EndsWith)
 V(Equals)
 V(Fill)
+V(FillAsync)
+V(FindFirstNotOf)
+V(FindFirstOf)
+V(FromBase32)
+V(FromBase32Into)
+V(FromBase64)
+V(FromBase64Into)
 V(FromHex)
+V(FromHexAsync)
+V(FromHexInto)
+V(Hash64)
+V(Histogram)
 V(IndexOf)
+V(IndexOfAsync)
+V(IsAscii)
+V(IsUtf8)
+V(LastIndexOf)
+V(LowerBound)
+V(Munmap)
+V(Not)
+V(Or)
+V(OrAsync)
 V(Reverse)
+V(SortFixed)
+V(SplitOffsets)
+V(StartsWith)
+V(Swap16)
+V(Swap32)
+V(Swap64)
+V(TimingSafeEquals)
+V(ToBase32)
+V(ToBase32Into)
+V(ToBase64)
+V(ToBase64Into)
 V(ToHex)
+V(ToHexAsync)
+V(ToHexInto)
+V(Xor)
+V(XorAsync)
 #undef V
 
-UNI_FUNCTION_CALLBACK(Concat) {
+const int CompilePatternStats = stats_register("CompilePattern");
+UNI_FUNCTION_CALLBACK(CompilePattern) {
   UNI_HANDLESCOPE();
+  StatsScope stats(CompilePatternStats, args);
 
-  size_t size = 0;
-  for (int index = 0, length = args.Length(); index < length; ++index) {
-    Local<Value> arg = args[index];
-    if (arg->IsString()) {
-      // Utf8Length() because we need the length in bytes, not characters
-      size += arg->ToString()->Utf8Length();
+  // Compile the buffer itself when invoked as a prototype method.
+  Local<Value> needle = args[0];
+  if (node::Buffer::HasInstance(args.This())) {
+    needle = args.This();
+  }
+
+  Local<Value> argv[] = { needle };
+  UNI_RETURN(UNI_FUNCTION_NEW_INSTANCE(Pattern::constructor, 1, argv));
+}
+
+UNI_FUNCTION_CALLBACK(CreateHexDecoder) {
+  UNI_HANDLESCOPE();
+  UNI_RETURN(UNI_FUNCTION_NEW_INSTANCE(HexDecoder::constructor, 0, NULL));
+}
+
+UNI_FUNCTION_CALLBACK(CreateHash64) {
+  UNI_HANDLESCOPE();
+  Local<Value> argv[] = { args[0] };
+  UNI_RETURN(UNI_FUNCTION_NEW_INSTANCE(Hasher::constructor, 1, argv));
+}
+
+UNI_FUNCTION_CALLBACK(CreateBufferList) {
+  UNI_HANDLESCOPE();
+  UNI_RETURN(UNI_FUNCTION_NEW_INSTANCE(BufferList::constructor, 0, NULL));
+}
+
+const int CreateMatcherStats = stats_register("CreateMatcher");
+UNI_FUNCTION_CALLBACK(CreateMatcher) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(CreateMatcherStats, args);
+  Local<Value> argv[] = { args[0] };
+  UNI_RETURN(UNI_FUNCTION_NEW_INSTANCE(Matcher::constructor, 1, argv));
+}
+
+// Sets the number of pool threads that an async action is spread over and
+// the size of the ranges that they work on.
+UNI_FUNCTION_CALLBACK(SetParallelism) {
+  UNI_HANDLESCOPE();
+
+  const int32_t workers = args[0]->Int32Value();
+  const int32_t range_size = args[1]->IsUndefined() ?
+      (int32_t) parallel_range_size : args[1]->Int32Value();
+  if (workers < 1 || range_size < 1) {
+    UNI_THROW_AND_RETURN(Exception::RangeError,
+                         "Arguments should be positive integers.");
+  }
+
+  parallel_workers = workers;
+  parallel_range_size = range_size;
+  UNI_RETURN(UNI_INTEGER_NEW(workers));
+}
+
+// Arguments: [enabled=true]. Turns the stats of the calling thread on or off.
+// Returns whether they were on.
+UNI_FUNCTION_CALLBACK(EnableStats) {
+  UNI_HANDLESCOPE();
+
+  const bool enabled = stats_enabled;
+  stats_enabled = args[0]->IsUndefined() || args[0]->BooleanValue();
+  UNI_RETURN(UNI_BOOLEAN_NEW(enabled));
+}
+
+UNI_FUNCTION_CALLBACK(ResetStats) {
+  UNI_HANDLESCOPE();
+
+  stats_reset();
+  UNI_RETURN(args.This());
+}
+
+// Arguments: [values]. Returns the names of the functions that have stats and
+// stores their stats in |values|, a Float64Array with room for kStatsFields
+// numbers per function, in the same order.
+const size_t kStatsFields = 5 + STATS_LATENCY_BUCKETS;
+
+UNI_FUNCTION_CALLBACK(Stats) {
+  UNI_HANDLESCOPE();
+
+  const size_t actions = stats_actions;
+  double* values = NULL;
+  if (!args[0]->IsUndefined()) {
+    size_t length;
+    values = static_cast<double*>(
+        typedArrayData(args[0], kFloat64Array, &length));
+    if (values == NULL || length < actions * kStatsFields) {
+      UNI_THROW_AND_RETURN(Exception::TypeError,
+                           "Argument should be a Float64Array with room for "
+                           "the stats of every function.");
     }
-    else if (node::Buffer::HasInstance(arg)) {
-      size += node::Buffer::Length(arg->ToObject());
+  }
+
+  Local<v8::Array> names = UNI_ARRAY_NEW(actions);
+  for (size_t i = 0; i < actions; ++i) {
+    names->Set(i, UNI_CURRENT_STRING_NEW(stats_names[i]));
+    if (values == NULL) {
+      continue;
     }
-    else {
-      char errmsg[256];
-      snprintf(errmsg,
-               sizeof(errmsg),
-               "Argument #%lu is neither a string nor a buffer object.",
-               static_cast<unsigned long>(index));
-      UNI_THROW_AND_RETURN(Exception::TypeError, errmsg);
+    const action_stats& stats = stats_table[i];
+    double* row = values + i * kStatsFields;
+    row[0] = (double) stats.calls;
+    row[1] = (double) stats.bytes;
+    row[2] = (double) stats.allocations;
+    row[3] = (double) stats.allocated_bytes;
+    row[4] = (double) stats.time;
+    for (size_t k = 0; k < STATS_LATENCY_BUCKETS; ++k) {
+      row[5 + k] = (double) stats.latency[k];
     }
   }
+  UNI_RETURN(names);
+}
 
-  Local<Object> buffer = UNI_BUFFER_NEW(size);
-  uint8_t* s = (uint8_t*) node::Buffer::Data(buffer);
+const int MmapStats = stats_register("Mmap");
 
-  for (int index = 0, length = args.Length(); index < length; ++index) {
-    Local<Value> arg = args[index];
-    if (arg->IsString()) {
-      String::Utf8Value v(arg);
-      memcpy(s, *v, v.length());
-      s += v.length();
+// Arguments: path, [offset], [length], [options]. Returns a buffer that is
+// backed by a read-only mapping of the file.
+UNI_FUNCTION_CALLBACK(Mmap) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(MmapStats, args);
+
+  if (!args[0]->IsString()) {
+    UNI_THROW_AND_RETURN(Exception::TypeError, "Path should be a string.");
+  }
+
+  Local<Value> result;
+  uint64_t offset, length;
+  mapped_file_advice advice;
+  bool will_need;
+  if (mappedFileArguments(&offset, &length, &advice, &will_need, args)) {
+    StringBytes s(args[0]);
+    const std::string path((const char*) s.data(), s.length());
+    result = mapFile(path, offset, length, advice, will_need, args);
+    if (!result.IsEmpty()) {
+      stats.set_bytes(node::Buffer::Length(result));
     }
-    else if (node::Buffer::HasInstance(arg)) {
-      Local<Object> b = arg->ToObject();
-      const uint8_t* data = (const uint8_t*) node::Buffer::Data(b);
-      size_t length = node::Buffer::Length(b);
-      memcpy(s, data, length);
-      s += length;
+  }
+
+  UNI_RETURN(result);
+}
+
+const int ConcatStats = stats_register("Concat");
+UNI_FUNCTION_CALLBACK(Concat) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(ConcatStats, args);
+
+  Local<Object> buffer;
+  size_t size;
+  std::vector<size_t> lengths;
+  if (concatSize(&size, &lengths, args, 0)) {
+    stats.set_bytes(size);
+    buffer = UNI_BUFFER_NEW(size);
+    concatCopy((uint8_t*) node::Buffer::Data(buffer), lengths, args, 0);
+  }
+
+  UNI_RETURN(buffer);
+}
+
+const int CompareManyStats = stats_register("CompareMany");
+
+// Arguments: results (Int32Array), items, offsets, operand. The results are
+// what compare() returns.
+UNI_FUNCTION_CALLBACK(CompareMany) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(CompareManyStats, args);
+
+  Local<Value> result;
+  BatchItems items;
+  std::string operand;
+  int32_t* results;
+  if (items.init(args[1], args[2], args) &&
+      batchOperand(&operand, args[3], args) &&
+      (results = static_cast<int32_t*>(
+          batchResults(args[0], kInt32Array, items.size(), args)))) {
+    stats.set_bytes(items.bytes());
+    const uint8_t* data = (const uint8_t*) operand.data();
+    const size_t size = operand.size();
+    for (size_t i = 0; i < items.size(); ++i) {
+      results[i] = compare(items.data(i), items.length(i), data, size);
     }
-    else {
-      UNI_THROW_AND_RETURN(Exception::Error,
-                           "Congratulations! You have run into a bug: argument "
-                           "is neither a string nor a buffer object.  Please "
-                           "make the world a better place and report it.");
+    result = args[0];
+  }
+
+  UNI_RETURN(result);
+}
+
+const int EqualsManyStats = stats_register("EqualsMany");
+
+// Arguments: results (Uint8Array), items, offsets, operand.
+UNI_FUNCTION_CALLBACK(EqualsMany) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(EqualsManyStats, args);
+
+  Local<Value> result;
+  BatchItems items;
+  std::string operand;
+  uint8_t* results;
+  if (items.init(args[1], args[2], args) &&
+      batchOperand(&operand, args[3], args) &&
+      (results = static_cast<uint8_t*>(
+          batchResults(args[0], kUint8Array, items.size(), args)))) {
+    stats.set_bytes(items.bytes());
+    const uint8_t* data = (const uint8_t*) operand.data();
+    const size_t size = operand.size();
+    for (size_t i = 0; i < items.size(); ++i) {
+      results[i] = items.length(i) == size &&
+                   mem_equal(items.data(i), data, size);
     }
+    result = args[0];
   }
 
-  UNI_RETURN(buffer);
+  UNI_RETURN(result);
+}
+
+const int IndexOfManyStats = stats_register("IndexOfMany");
+
+// Arguments: results (Int32Array), items, offsets, needle, start. The
+// needle is prepared once for the whole batch.
+UNI_FUNCTION_CALLBACK(IndexOfMany) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(IndexOfManyStats, args);
+
+  Local<Value> result;
+  BatchItems items;
+  std::string needle;
+  int32_t* results;
+  if (items.init(args[1], args[2], args) &&
+      batchOperand(&needle, args[3], args) &&
+      (results = static_cast<int32_t*>(
+          batchResults(args[0], kInt32Array, items.size(), args)))) {
+    stats.set_bytes(items.bytes());
+    search_pattern pattern;
+    search_prepare(&pattern, (const uint8_t*) needle.data(), needle.size());
+
+    const int32_t offset = args[4]->Int32Value();
+    for (size_t i = 0; i < items.size(); ++i) {
+      const uint8_t* data = items.data(i);
+      const size_t size = items.length(i);
+      const size_t start = clampOffset(offset, size);
+      const uint8_t* p = search_pattern_first(&pattern,
+                                              data + start,
+                                              size - start);
+      results[i] = p ? (int32_t) (p - data) : -1;
+    }
+
+    search_release(&pattern);
+    result = args[0];
+  }
+
+  UNI_RETURN(result);
+}
+
+const int ToHexManyStats = stats_register("ToHexMany");
+
+// Arguments: items, offsets. Returns an array of strings.
+UNI_FUNCTION_CALLBACK(ToHexMany) {
+  UNI_HANDLESCOPE();
+  StatsScope stats(ToHexManyStats, args);
+
+  Local<v8::Array> results;
+  BatchItems items;
+  if (items.init(args[0], args[1], args)) {
+    stats.set_bytes(items.bytes());
+    results = UNI_ARRAY_NEW(items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+      results->Set(i, encodeHex(items.data(i), items.length(i), args));
+    }
+  }
+
+  UNI_RETURN(results);
 }
 
 void RegisterModule(Handle<Object> target) {
+  BufferList::Initialize();
+  Hasher::Initialize();
+  HexDecoder::Initialize();
+  Matcher::Initialize();
+  Pattern::Initialize();
+
+  NODE_SET_METHOD(target, "and", And);
+  NODE_SET_METHOD(target, "andAsync", AndAsync);
+  NODE_SET_METHOD(target, "binarySearchFixed", BinarySearchFixed);
   NODE_SET_METHOD(target, "clear", Clear);
   NODE_SET_METHOD(target, "compare", Compare);
+  NODE_SET_METHOD(target, "compareMany", CompareMany);
+  NODE_SET_METHOD(target, "comparePrefix", ComparePrefix);
+  NODE_SET_METHOD(target, "compilePattern", CompilePattern);
   NODE_SET_METHOD(target, "concat", Concat);
+  NODE_SET_METHOD(target, "concatInto", ConcatInto);
+  NODE_SET_METHOD(target, "count", Count);
+  NODE_SET_METHOD(target, "crc32c", Crc32c);
+  NODE_SET_METHOD(target, "createBufferList", CreateBufferList);
+  NODE_SET_METHOD(target, "createHash64", CreateHash64);
+  NODE_SET_METHOD(target, "createHexDecoder", CreateHexDecoder);
+  NODE_SET_METHOD(target, "createMatcher", CreateMatcher);
+  NODE_SET_METHOD(target, "enableStats", EnableStats);
+  NODE_SET_METHOD(target, "endsWith", EndsWith);
   NODE_SET_METHOD(target, "equals", Equals);
+  NODE_SET_METHOD(target, "equalsMany", EqualsMany);
   NODE_SET_METHOD(target, "fill", Fill);
+  NODE_SET_METHOD(target, "fillAsync", FillAsync);
+  NODE_SET_METHOD(target, "findFirstNotOf", FindFirstNotOf);
+  NODE_SET_METHOD(target, "findFirstOf", FindFirstOf);
+  NODE_SET_METHOD(target, "fromBase32", FromBase32);
+  NODE_SET_METHOD(target, "fromBase32Into", FromBase32Into);
+  NODE_SET_METHOD(target, "fromBase64", FromBase64);
+  NODE_SET_METHOD(target, "fromBase64Into", FromBase64Into);
   NODE_SET_METHOD(target, "fromHex", FromHex);
+  NODE_SET_METHOD(target, "fromHexAsync", FromHexAsync);
+  NODE_SET_METHOD(target, "fromHexInto", FromHexInto);
+  NODE_SET_METHOD(target, "hash64", Hash64);
+  NODE_SET_METHOD(target, "histogram", Histogram);
   NODE_SET_METHOD(target, "indexOf", IndexOf);
+  NODE_SET_METHOD(target, "indexOfAsync", IndexOfAsync);
+  NODE_SET_METHOD(target, "indexOfMany", IndexOfMany);
+  NODE_SET_METHOD(target, "isAscii", IsAscii);
+  NODE_SET_METHOD(target, "isUtf8", IsUtf8);
+  NODE_SET_METHOD(target, "lastIndexOf", LastIndexOf);
+  NODE_SET_METHOD(target, "lowerBound", LowerBound);
+  NODE_SET_METHOD(target, "mmap", Mmap);
+  NODE_SET_METHOD(target, "munmap", Munmap);
+  NODE_SET_METHOD(target, "not", Not);
+  NODE_SET_METHOD(target, "or", Or);
+  NODE_SET_METHOD(target, "orAsync", OrAsync);
+  NODE_SET_METHOD(target, "resetStats", ResetStats);
   NODE_SET_METHOD(target, "reverse", Reverse);
+  NODE_SET_METHOD(target, "setParallelism", SetParallelism);
+  NODE_SET_METHOD(target, "sortFixed", SortFixed);
+  NODE_SET_METHOD(target, "splitOffsets", SplitOffsets);
+  NODE_SET_METHOD(target, "startsWith", StartsWith);
+  NODE_SET_METHOD(target, "stats", Stats);
+  NODE_SET_METHOD(target, "swap16", Swap16);
+  NODE_SET_METHOD(target, "swap32", Swap32);
+  NODE_SET_METHOD(target, "swap64", Swap64);
+  NODE_SET_METHOD(target, "timingSafeEquals", TimingSafeEquals);
+  NODE_SET_METHOD(target, "toBase32", ToBase32);
+  NODE_SET_METHOD(target, "toBase32Into", ToBase32Into);
+  NODE_SET_METHOD(target, "toBase64", ToBase64);
+  NODE_SET_METHOD(target, "toBase64Into", ToBase64Into);
   NODE_SET_METHOD(target, "toHex", ToHex);
+  NODE_SET_METHOD(target, "toHexAsync", ToHexAsync);
+  NODE_SET_METHOD(target, "toHexInto", ToHexInto);
+  NODE_SET_METHOD(target, "toHexMany", ToHexMany);
+  NODE_SET_METHOD(target, "xor", Xor);
+  NODE_SET_METHOD(target, "xorAsync", XorAsync);
 }
 
 } // anonymous namespace
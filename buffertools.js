@@ -18,6 +18,8 @@ var Buffer = require('buffer').Buffer;
 
 // requires node 3.1
 var events = require('events');
+var os = require('os');
+var stream = require('stream');
 var util = require('util');
 
 try {
@@ -27,6 +29,160 @@ try {
 	var buffertools = require('./build/Debug/buffertools.node');
 }
 
+// Buffers that are smaller than this many bytes are not worth a trip to the
+// thread pool, the async variants run the synchronous action for them.
+exports.asyncThreshold = 64 * 1024;
+
+// Big buffers are split over this many pool threads. libuv's pool has four
+// threads unless UV_THREADPOOL_SIZE says otherwise. Only half of them are
+// used, fs, dns and crypto requests queue behind buffertools otherwise.
+var workers = Math.min(os.cpus().length, +process.env.UV_THREADPOOL_SIZE || 4);
+buffertools.setParallelism(Math.max(1, workers >> 1));
+
+// Wraps the native fooAsync() so that it accepts an optional callback and
+// returns a promise without one. Errors, including argument errors, are
+// always passed to the callback, never thrown. The callback's third argument
+// says how the work was done: 'sync', 'thread' or 'parallel'.
+function wrapAsync(name) {
+	var async = buffertools[name + 'Async'];
+	var sync = buffertools[name];
+
+	buffertools[name + 'Async'] = function() {
+		var self = this;
+		var args = Array.prototype.slice.call(arguments);
+		var callback = null;
+		if (typeof args[args.length - 1] === 'function') {
+			callback = args.pop();
+		}
+		var target = Buffer.isBuffer(this) ? this : args[0];
+
+		function run(callback) {
+			try {
+				if (Buffer.isBuffer(target) && target.length < exports.asyncThreshold) {
+					var result = sync.apply(self, args);
+					process.nextTick(function() { callback(null, result, 'sync'); });
+				} else {
+					async.apply(self, args.concat(callback));
+				}
+			} catch (e) {
+				process.nextTick(function() { callback(e); });
+			}
+		}
+
+		if (callback) {
+			return run(callback);
+		}
+		if (typeof Promise !== 'function') {
+			throw new TypeError('Callback should be a function.');
+		}
+		return new Promise(function(resolve, reject) {
+			run(function(err, result) {
+				if (err) reject(err);
+				else resolve(result);
+			});
+		});
+	};
+}
+['and', 'fill', 'fromHex', 'indexOf', 'or', 'toHex', 'xor'].forEach(wrapAsync);
+
+// Wraps a native batch action so that it allocates the typed array that
+// the results are stored in. The native function takes the results, the
+// items, the offsets (or null) and the operand.
+function wrapMany(name, Results) {
+	var native = buffertools[name];
+
+	buffertools[name] = function(items) {
+		var args = Array.prototype.slice.call(arguments);
+		if (!(args[1] instanceof Uint32Array)) {
+			args.splice(1, 0, null);
+		}
+		var size = args[1] ? Math.max(0, args[1].length - 1) : items.length;
+		return native.apply(this, [new Results(size >>> 0)].concat(args));
+	};
+}
+wrapMany('compareMany', Int32Array);
+wrapMany('equalsMany', Uint8Array);
+wrapMany('indexOfMany', Int32Array);
+
+// Splits a buffer at every occurrence of the delimiter and returns the
+// fields as slices of it. The native splitOffsets() finds them in one pass
+// and stores them as offset, length pairs in a scratch array that is only
+// replaced for splits with more fields than fit in it.
+var splitScratch = new Int32Array(2 * 256);
+
+buffertools.split = function() {
+	var args = Array.prototype.slice.call(arguments);
+	var buffer = Buffer.isBuffer(this) ? this : args.shift();
+	var delimiter = args[0], limit = args[1], encoding = args[2];
+
+	var offsets = splitScratch;
+	var n = buffertools.splitOffsets(buffer, delimiter, offsets, limit, encoding);
+	if (2 * n > offsets.length) {
+		offsets = new Int32Array(2 * n);
+		buffertools.splitOffsets(buffer, delimiter, offsets, limit, encoding);
+	}
+
+	var fields = new Array(n);
+	for (var i = 0; i < n; i++) {
+		var start = offsets[2 * i];
+		fields[i] = buffer.slice(start, start + offsets[2 * i + 1]);
+	}
+	return fields;
+};
+
+// Allocates the array that the native histogram() adds the counts to when
+// the caller doesn't pass one in.
+var histogram = buffertools.histogram;
+
+buffertools.histogram = function() {
+	var args = Array.prototype.slice.call(arguments);
+	var buffer = Buffer.isBuffer(this) ? this : args.shift();
+	return histogram(buffer, args[0] || new Uint32Array(256));
+};
+
+// Turns the native stats() into an object keyed by function, with only the
+// functions that were called. Every native function keeps five counters and
+// a latency histogram, see Stats.h.
+var STATS_FIELDS = 5 + 32;
+var stats = buffertools.stats;
+
+buffertools.stats = function() {
+	var names = stats();
+	var values = new Float64Array(names.length * STATS_FIELDS);
+	stats(values);
+
+	var result = {};
+	for (var i = 0; i < names.length; i++) {
+		var row = values.subarray(i * STATS_FIELDS, (i + 1) * STATS_FIELDS);
+		if (row[0] === 0) {
+			continue;
+		}
+		result[names[i].charAt(0).toLowerCase() + names[i].slice(1)] = {
+			calls: row[0],
+			bytes: row[1],
+			allocations: row[2],
+			allocatedBytes: row[3],
+			time: row[4],
+			latency: Array.prototype.slice.call(row, 5)
+		};
+	}
+	return result;
+};
+
+// Module functions that don't take a buffer. extend() leaves them off the
+// buffer prototypes.
+var MODULE_ONLY = {
+	createBufferList: true,
+	createHash64: true,
+	createHexDecoder: true,
+	createMatcher: true,
+	enableStats: true,
+	mmap: true,
+	resetStats: true,
+	setParallelism: true,
+	stats: true
+};
+
 exports.extend = function() {
 	var receivers;
 	if (arguments.length > 0) {
@@ -39,7 +195,9 @@ exports.extend = function() {
 	for (var i = 0, n = receivers.length; i < n; i += 1) {
 		var receiver = receivers[i];
 		for (var key in buffertools) {
-			receiver[key] = buffertools[key];
+			if (receiver === exports || !MODULE_ONLY.hasOwnProperty(key)) {
+				receiver[key] = buffertools[key];
+			}
 		}
 		if (receiver !== exports) {
 			receiver.concat = function() {
@@ -57,37 +215,63 @@ exports.extend(exports);
 // - never emits 'error'
 // - never emits 'drain'
 //
+// Writes are copied into a list of chunks that grow geometrically, so
+// appending is linear in the amount of data. The chunks are joined once,
+// when getBuffer() is called.
+//
+var MIN_CHUNK_SIZE = 8192;
+var MAX_CHUNK_SIZE = 8 * 1024 * 1024;
+
 function WritableBufferStream() {
 	this.writable = true;
-	this.buffer = null;
+	this.chunks = [];
+	this.used = 0;	// bytes in use in the last chunk
 }
 
 util.inherits(WritableBufferStream, events.EventEmitter);
 
+// Returns the last chunk after making sure it has room for |size| bytes.
+WritableBufferStream.prototype._reserve = function(size) {
+	var n = this.chunks.length;
+	var last = this.chunks[n - 1];
+
+	if (last && last.length - this.used >= size) {
+		return last;
+	}
+
+	var chunkSize = MIN_CHUNK_SIZE;
+	if (last) {
+		this.chunks[n - 1] = last.slice(0, this.used);
+		chunkSize = Math.min(last.length * 2, MAX_CHUNK_SIZE);
+	}
+
+	last = new Buffer(Math.max(size, chunkSize));
+	this.chunks.push(last);
+	this.used = 0;
+	return last;
+};
+
 WritableBufferStream.prototype._append = function(buffer, encoding) {
 	if (!this.writable) {
 		throw new Error('Stream is not writable.');
 	}
 
+	var chunk;
 	if (Buffer.isBuffer(buffer)) {
-		// no action required
+		chunk = this._reserve(buffer.length);
+		buffer.copy(chunk, this.used);
+		this.used += buffer.length;
 	}
 	else if (typeof buffer == 'string') {
-		// TODO optimize
-		buffer = new Buffer(buffer, encoding || 'utf8');
+		// encode straight into the chunk
+		encoding = encoding || 'utf8';
+		var size = Buffer.byteLength(buffer, encoding);
+		chunk = this._reserve(size);
+		this.used += chunk.write(buffer, this.used, size, encoding);
 	}
 	else {
 		throw new Error('Argument should be either a buffer or a string.');
 	}
-
-	// FIXME optimize!
-	if (this.buffer) {
-		this.buffer = buffertools.concat(this.buffer, buffer);
-	}
-	else {
-		this.buffer = new Buffer(buffer.length);
-		buffer.copy(this.buffer);
-	}
 };
 
 WritableBufferStream.prototype.write = function(buffer, encoding) {
@@ -108,10 +292,47 @@ WritableBufferStream.prototype.end = function(buffer, encoding) {
 };
 
 WritableBufferStream.prototype.getBuffer = function() {
-	if (this.buffer) {
-		return this.buffer;
+	var n = this.chunks.length;
+	if (n === 0) {
+		return new Buffer(0);
+	}
+
+	if (this.chunks[n - 1].length > this.used) {
+		this.chunks[n - 1] = this.chunks[n - 1].slice(0, this.used);
+	}
+	if (n > 1) {
+		this.chunks = [buffertools.concat.apply(buffertools, this.chunks)];
+	}
+	this.used = this.chunks[0].length;
+
+	return this.chunks[0];
+};
+
+// Calls fn() with every chunk of data, without joining them.
+WritableBufferStream.prototype._forEachChunk = function(fn) {
+	var n = this.chunks.length;
+	for (var i = 0; i < n; i += 1) {
+		var chunk = this.chunks[i];
+		fn(i < n - 1 ? chunk : chunk.slice(0, this.used));
 	}
-	return new Buffer(0);
+};
+
+// Returns the CRC-32C of everything written so far, continuing from |prev|.
+WritableBufferStream.prototype.crc32c = function(prev) {
+	var crc = prev >>> 0;
+	this._forEachChunk(function(chunk) {
+		crc = buffertools.crc32c(chunk, crc);
+	});
+	return crc;
+};
+
+// Returns the xxHash64 of everything written so far.
+WritableBufferStream.prototype.hash64 = function(seed) {
+	var hash = buffertools.createHash64(seed);
+	this._forEachChunk(function(chunk) {
+		hash.update(chunk);
+	});
+	return hash.digest();
 };
 
 WritableBufferStream.prototype.toString = function() {
@@ -119,3 +340,161 @@ WritableBufferStream.prototype.toString = function() {
 };
 
 exports.WritableBufferStream = WritableBufferStream;
+
+//
+// HexEncoder and HexDecoder
+//
+// Transform streams that hex encode or decode the data that passes through
+// them. The output is carved out of shared slabs of HEX_SLAB_SIZE bytes,
+// like node's own buffer pool, and no output chunk is bigger than a slab,
+// so memory use doesn't depend on the size of the input chunks.
+//
+var HEX_SLAB_SIZE = 64 * 1024;
+
+function HexSlab() {
+	this.slab = null;
+	this.used = 0;
+}
+
+// Returns a slab with room for |size| bytes at this.used.
+HexSlab.prototype.reserve = function(size) {
+	if (this.slab === null || this.slab.length - this.used < size) {
+		this.slab = new Buffer(HEX_SLAB_SIZE);
+		this.used = 0;
+	}
+	return this.slab;
+};
+
+// Returns the |size| bytes at this.used and moves past them.
+HexSlab.prototype.take = function(size) {
+	var chunk = this.slab.slice(this.used, this.used + size);
+	this.used += size;
+	return chunk;
+};
+
+function HexEncoder(options) {
+	if (!(this instanceof HexEncoder)) {
+		return new HexEncoder(options);
+	}
+	stream.Transform.call(this, options);
+	this._slab = new HexSlab();
+}
+
+util.inherits(HexEncoder, stream.Transform);
+
+HexEncoder.prototype._transform = function(chunk, encoding, callback) {
+	var step = HEX_SLAB_SIZE / 2;
+	for (var i = 0; i < chunk.length; i += step) {
+		var piece = chunk.slice(i, i + step);
+		var slab = this._slab.reserve(piece.length * 2);
+		buffertools.toHexInto(piece, slab, this._slab.used);
+		this.push(this._slab.take(piece.length * 2));
+	}
+	callback();
+};
+
+function HexDecoder(options) {
+	if (!(this instanceof HexDecoder)) {
+		return new HexDecoder(options);
+	}
+	stream.Transform.call(this, options);
+	this._slab = new HexSlab();
+	this._decoder = buffertools.createHexDecoder();
+}
+
+util.inherits(HexDecoder, stream.Transform);
+
+HexDecoder.prototype._transform = function(chunk, encoding, callback) {
+	var step = HEX_SLAB_SIZE * 2;
+	try {
+		for (var i = 0; i < chunk.length; i += step) {
+			var piece = chunk.slice(i, i + step);
+			var slab = this._slab.reserve((piece.length >> 1) + 1);
+			var size = this._decoder.decode(piece, slab, this._slab.used);
+			if (size > 0) {
+				this.push(this._slab.take(size));
+			}
+		}
+	} catch (e) {
+		return callback(e);
+	}
+	callback();
+};
+
+HexDecoder.prototype._flush = function(callback) {
+	try {
+		this._decoder.end();
+	} catch (e) {
+		return callback(e);
+	}
+	callback();
+};
+
+exports.HexEncoder = HexEncoder;
+exports.HexDecoder = HexDecoder;
+
+//
+// Splitter
+//
+// A transform stream that splits its input at every occurrence of a
+// delimiter and emits the records as buffers. Records that lie within a
+// chunk are slices of it, only a record that spans chunks is copied. The
+// incomplete record at the end of a chunk is kept in a buffer list until a
+// later chunk completes it, so a delimiter that straddles two chunks is
+// found too. An empty record after the last delimiter is not emitted.
+//
+function Splitter(delimiter, options) {
+	if (!(this instanceof Splitter)) {
+		return new Splitter(delimiter, options);
+	}
+	var copy = {};
+	for (var key in options) {
+		copy[key] = options[key];
+	}
+	copy.readableObjectMode = true;
+	stream.Transform.call(this, copy);
+	this._delimiter = Buffer.isBuffer(delimiter) ? delimiter : new Buffer(delimiter);
+	if (this._delimiter.length === 0) {
+		throw new Error('Delimiter should not be empty.');
+	}
+	this._tail = buffertools.createBufferList();
+}
+
+util.inherits(Splitter, stream.Transform);
+
+Splitter.prototype._transform = function(chunk, encoding, callback) {
+	var start = 0;
+	var tail = this._tail;
+	if (tail.length > 0) {
+		// The delimiter that ends the tail may start in the tail.
+		var from = Math.max(0, tail.length - this._delimiter.length + 1);
+		var carried = tail.length;
+		tail.push(chunk);
+		var end = tail.indexOf(this._delimiter, from);
+		if (end === -1) {
+			return callback();
+		}
+		this.push(tail.slice(0, end));
+		this._tail = buffertools.createBufferList();
+		start = end + this._delimiter.length - carried;
+	}
+
+	var records = buffertools.split(chunk.slice(start), this._delimiter);
+	for (var i = 0; i < records.length - 1; i++) {
+		this.push(records[i]);
+	}
+	var last = records[records.length - 1];
+	if (last.length > 0) {
+		this._tail.push(last);
+	}
+	callback();
+};
+
+Splitter.prototype._flush = function(callback) {
+	if (this._tail.length > 0) {
+		this.push(this._tail.consume());
+	}
+	callback();
+};
+
+exports.Splitter = Splitter;
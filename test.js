@@ -16,6 +16,9 @@
 var buffertools = require('./buffertools');
 var Buffer = require('buffer').Buffer;
 var assert = require('assert');
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
 
 var WritableBufferStream = buffertools.WritableBufferStream;
 
@@ -40,6 +43,47 @@ assert.ok(a.compare('abcd') == 0);
 assert.ok(a.compare('efgh') < 0);
 assert.ok(c.compare('abcd') > 0);
 
+// compare ranges, in the order of Buffer#compare()
+b = new Buffer('xxabcdxx');
+assert.equal(0, b.compare(a, 0, 4, 2, 6));
+assert.equal(0, b.compare('--abcd', 2, undefined, 2, 6));
+assert.equal(1, b.compare(a, 0, 3, 2, 6));
+assert.equal(-1, b.compare(c, 0, 4, 2, 6));
+assert.equal(0, b.compare(a, 4, 4, 8));
+
+assert.ok(b.startsWith('xxab'));
+assert.ok(b.startsWith(''));
+assert.ok(!b.startsWith('xxabcdxxx'));
+assert.ok(b.endsWith(new Buffer('cdxx')));
+assert.ok(!b.endsWith('cdx'));
+assert.equal(0, b.comparePrefix('xxabzz', 4));
+assert.equal(-1, b.comparePrefix('xxabzz', 5));
+assert.equal(1, b.comparePrefix('xx', 3));
+assert.equal(0, b.comparePrefix('', 0));
+assert.throws(function() { b.comparePrefix('xx'); }, TypeError);
+assert.throws(function() { b.comparePrefix('xx', -1); }, RangeError);
+
+assert.ok(a.timingSafeEquals(b.slice(2, 6)));
+assert.ok(a.timingSafeEquals('abcd'));
+assert.ok(!a.timingSafeEquals('abce'));
+assert.ok(!a.timingSafeEquals('abc'));
+
+// the SIMD kernels, with the difference in every position of every tail
+for (var n = 1; n < 200; n += 1 + (n >> 5)) {
+	var x = new Buffer(n), y = new Buffer(n);
+	for (var i = 0; i < n; i++) x[i] = y[i] = i * 31;
+	for (var i = 0; i < n; i++) {
+		y[i] = x[i] + 1 & 255;
+		var order = x[i] < y[i] ? -1 : 1;
+		assert.equal(order, x.compare(y));
+		assert.equal(-order, y.compare(x));
+		assert.ok(!x.equals(y));
+		assert.ok(!x.timingSafeEquals(y));
+		y[i] = x[i];
+	}
+	assert.ok(x.equals(y) && x.timingSafeEquals(y) && x.compare(y) === 0);
+}
+
 b = new Buffer('****');
 assert.equal(b, b.clear());
 assert.equal(b.inspect(), '<Buffer 00 00 00 00>');	// FIXME brittle test
@@ -60,6 +104,30 @@ b = new Buffer(4);
 assert.equal(b, b.fill('abcd1234'));
 assert.equal(b.inspect(), '<Buffer 61 62 63 64>');
 
+// fill ranges, node's argument order
+b = new Buffer('--------');
+assert.equal('--abab--', b.fill('ab', 2, 6).toString());
+assert.equal('--abab**', b.fill(42, -2).toString());
+assert.equal('xxabab**', b.fill('x', 0, 2, 'latin1').toString());
+assert.equal('xxabab**', b.fill('y', 5, 3).toString());
+assert.equal('\u00e9\u00e9\u00e9\u00e9ab\u00e9\u00e9', b.fill('\u00e9', 'latin1').fill('ab', 4, 6).toString('latin1'));
+
+// patterns of every size up to and past the doubling block, and big enough
+// to use non-temporal stores
+[1, 3, 7, 64, 1000, 20000].forEach(function(n) {
+	var pattern = new Buffer(n);
+	for (var i = 0; i < n; i++) pattern[i] = Math.random() * 256 | 0;
+	[Math.max(1, n - 1), 100003, 9 << 20].forEach(function(size) {
+		var b = new Buffer(size + 2);
+		b[0] = b[size + 1] = 42;
+		b.fill(pattern, 1, size + 1);
+		assert.equal(42, b[0]);
+		assert.equal(42, b[size + 1]);
+		for (var i = 1; i <= size; i += 997) assert.equal(pattern[(i - 1) % n], b[i]);
+		assert.equal(pattern[(size - 1) % n], b[size]);
+	});
+});
+
 b = new Buffer('Hello, world!');
 assert.equal(-1, b.indexOf(new Buffer('foo')));
 assert.equal(0,  b.indexOf(new Buffer('Hell')));
@@ -81,6 +149,50 @@ assert.equal(-1, b.indexOf('world', -5));
 assert.equal(-1, b.indexOf('world', 256));
 assert.equal(-1, b.indexOf('', 256));
 
+assert.equal(-1, b.lastIndexOf(new Buffer('foo')));
+assert.equal(7,  b.lastIndexOf(new Buffer('world')));
+assert.equal(12, b.lastIndexOf('!'));
+assert.equal(8,  b.lastIndexOf('o'));
+assert.equal(4,  b.lastIndexOf('o', 8));
+assert.equal(4,  b.lastIndexOf('o', -5));
+assert.equal(-1, b.lastIndexOf('o', 4));
+assert.equal(-1, b.lastIndexOf('world', 11));
+assert.equal(7,  b.lastIndexOf('world', 12));
+assert.equal(0,  b.lastIndexOf('Hello, world!'));
+assert.equal(-1, b.lastIndexOf('Hello, world!1'));
+assert.equal(-1, b.lastIndexOf(''));
+assert.equal(-1, b.lastIndexOf('H', -256));
+assert.equal(7,  b.lastIndexOf('world', 256));
+
+// non-ASCII strings, in UTF-8 or latin1, short and longer than the stack buffer
+b = new Buffer('caf\u00e9 \u20ac', 'latin1');
+assert.equal(3, b.indexOf('\u00e9 ', 0, 'latin1'));
+assert.equal(-1, b.indexOf('\u00e9 ', 0, 'utf8'));
+assert.equal(0, b.compare('caf\u00e9 \u20ac', 'ascii'));
+assert.ok(b.equals('caf\u00e9 \u20ac', 'binary'));
+assert.ok(!b.equals('caf\u00e9 \u20ac'));
+assert.equal(3, b.lastIndexOf('\u00e9', 6, 'latin1'));
+assert.throws(function() { b.indexOf('x', 0, 'hex'); }, TypeError);
+// encoding names ignore case, and the offset before them can be left out
+assert.equal('\u00e9\u00e9', new Buffer(2).fill('\u00e9', 'LATIN1').toString('latin1'));
+assert.equal('\u00e9', new Buffer(2).fill('\u00e9', 'UTF-8').toString());
+assert.equal(0, b.compare('caf\u00e9 \u20ac', 'Latin1'));
+assert.equal(3, buffertools.indexOf(new Buffer('abc\u00e9', 'latin1'), '\u00e9', 'latin1'));
+assert.equal(3, b.lastIndexOf('\u00e9', 'latin1'));
+assert.equal(3, b.findFirstOf('\u00e9\u20ac', 'latin1'));
+assert.equal(4, b.findFirstNotOf('caf\u00e9', 'latin1'));
+assert.equal(1, b.count('\u00e9', 'latin1'));
+assert.equal(1, b.count('\u00e9 ', 'Latin1'));
+assert.equal('\u00e9\u00e9\u00e9', new Buffer(6).fill('\u00e9').toString());
+assert.equal('\u00e9\u00e9\u00e9', new Buffer(3).fill('\u00e9', 'latin1').toString('latin1'));
+[10, 100, 1000].forEach(function(n) {
+	var s = new Array(n + 1).join('\u00e9\u20acx\ud83d\ude00');
+	assert.ok(new Buffer(s).equals(s));
+	assert.ok(new Buffer(s, 'latin1').equals(s, 'latin1'));
+	assert.equal(s + s, buffertools.concat(s, new Buffer(s)).toString());
+	assert.equal(s.length, new Buffer(s.length).concatInto(0, new Buffer(s, 'latin1')));
+});
+
 b = new Buffer("\t \r\n");
 assert.equal('09200d0a', b.toHex());
 assert.equal(b.toString(), new Buffer('09200d0a').fromHex().toString());
@@ -93,6 +205,77 @@ b[2] = 0x60;
 b[3] = 0x2f;
 assert.equal('9895602f', b.toHex());
 
+// cross-check the hex codec against node's own, around the SIMD block sizes
+for (var i = 0; i < 200; i++) {
+	var n = [0, 1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 600][i % 12] + (i >> 4);
+	b = new Buffer(n);
+	for (var k = 0; k < n; k++) b[k] = Math.random() * 256 | 0;
+	var hex = b.toString('hex');
+	assert.equal(hex, b.toHex());
+	assert.equal(hex, buffertools.fromHex(new Buffer(hex.toUpperCase())).toString('hex'));
+	if (n > 0) {
+		var bad = new Buffer(hex);
+		bad[Math.random() * bad.length | 0] = 'g@/:G`\xff'.charCodeAt(i % 7);
+		assert.throws(function() { bad.fromHex(); });
+	}
+}
+assert.throws(function() { new Buffer('abc').fromHex(); });
+
+b = new Buffer('--------');
+assert.equal(2, buffertools.fromHexInto(new Buffer('2a2A'), b, 3));
+assert.equal('---**---', b.toString());
+assert.equal(2, new Buffer('2a2a').fromHexInto(b));
+assert.equal('**-**---', b.toString());
+assert.equal(4, new Buffer('**').toHexInto(b, -4));
+assert.equal('**-*2a2a', b.toString());
+assert.equal(0, buffertools.toHexInto(new Buffer(0), b, 8));
+assert.throws(function() { buffertools.toHexInto(new Buffer('***'), b, 3); });
+assert.equal('**-*2a2a', b.toString());
+assert.throws(function() { buffertools.fromHexInto(new Buffer('2a2'), b); });
+assert.throws(function() { buffertools.fromHexInto(new Buffer('2x'), b); });
+assert.throws(function() { buffertools.fromHexInto(new Buffer('2a'), 'b'); });
+
+// base64 and base32, against node's encoder and the RFC 4648 test vectors
+for (var n = 0; n < 200; n++) {
+	b = new Buffer(n);
+	for (var i = 0; i < n; i++) b[i] = Math.random() * 256 | 0;
+	var base64 = b.toString('base64');
+	var base64url = base64.replace(/\+/g, '-').replace(/\//g, '_').replace(/=+$/, '');
+	assert.equal(base64, b.toBase64());
+	assert.equal(base64url, b.toBase64({ url: true }));
+	assert.equal(base64.replace(/=+$/, ''), b.toBase64({ padding: false }));
+	assert.ok(b.equals(new Buffer(base64).fromBase64()));
+	assert.ok(b.equals(new Buffer(base64url).fromBase64({ url: true })));
+	assert.ok(b.equals(new Buffer(b.toBase32()).fromBase32()));
+	assert.ok(b.equals(new Buffer(b.toBase32({ padding: false }).toLowerCase()).fromBase32()));
+}
+['', 'f', 'fo', 'foo', 'foob', 'fooba', 'foobar'].forEach(function(s, i) {
+	var base32 = ['', 'MY======', 'MZXQ====', 'MZXW6===', 'MZXW6YQ=', 'MZXW6YTB', 'MZXW6YTBOI======'];
+	assert.equal(base32[i], new Buffer(s).toBase32());
+	assert.equal(s, new Buffer(base32[i]).fromBase32().toString());
+});
+['Zm9v!', 'Z', 'Zg=', 'Zg===', 'Zm9vYmFyYmF6YmF6YmF6YmF6YmF6YmF6YmF6YmF6YmF6YmF6YmF6\n'].forEach(function(s) {
+	assert.throws(function() { new Buffer(s).fromBase64(); }, /base64/);
+});
+assert.throws(function() { new Buffer('Zm-v').fromBase64(); }, /base64/);
+assert.throws(function() { new Buffer('Zm+v').fromBase64({ url: true }); }, /base64/);
+['MY=====', 'MZX', 'MZXW6YQ1', 'M'].forEach(function(s) {
+	assert.throws(function() { new Buffer(s).fromBase32(); }, /base32/);
+});
+
+b = new Buffer('--------');
+assert.equal(4, new Buffer('**').toBase64Into(b, 2));
+assert.equal('--Kio=--', b.toString());
+assert.equal(2, new Buffer('*').toBase64Into(b, -2, { padding: false }));
+assert.equal('--Kio=Kg', b.toString());
+assert.equal(2, buffertools.fromBase64Into(new Buffer('Kio='), b, 6));
+assert.equal('--Kio=**', b.toString());
+assert.equal(2, new Buffer('FIVA').fromBase32Into(b));
+assert.equal(8, new Buffer('*****').toBase32Into(b));
+assert.equal('FIVCUKRK', b.toString());
+assert.throws(function() { new Buffer('***').toBase64Into(b, 5); }, RangeError);
+assert.throws(function() { new Buffer('FIVA').fromBase32Into(b, 7); }, RangeError);
+
 assert.equal('', buffertools.concat());
 assert.equal('', buffertools.concat(''));
 assert.equal('foobar', new Buffer('foo').concat('bar'));
@@ -103,9 +286,88 @@ a = new Buffer('For great justice.'), b = buffertools.concat(a);
 assert.equal(a.toString(), b.toString());
 assert.notEqual(a, b);
 
+b = new Buffer('---------');
+assert.equal(6, buffertools.concatInto(b, 2, 'foo', new Buffer('bar')));
+assert.equal('--foobar-', b.toString());
+assert.equal(3, b.concatInto(-3, 'baz'));
+assert.equal('--foobbaz', b.toString());
+assert.equal(0, b.concatInto(9));
+assert.throws(function() { b.concatInto(7, 'foo'); });
+assert.throws(function() { b.concatInto(0, 'foo', 123); });
+assert.equal('--foobbaz', b.toString());
+
+// bitwise operations
+b = new Buffer([0x0f, 0xf0, 0x55, 0xaa, 0x00]);
+assert.equal(b, b.xor(new Buffer([0xff, 0x0f])));
+assert.equal('f0ffaaa5ff', b.toHex());
+assert.equal('f000aa00ff', buffertools.and(b, new Buffer([0xff, 0x00])).toHex());
+assert.equal('f101ab01ff', b.or('\x01').toHex());
+assert.equal('0efe54fe00', b.not().toHex());
+a = new Buffer(5);
+assert.equal(a, buffertools.not(b, a));
+assert.equal('f101ab01ff', a.toHex());
+assert.equal('0efe54fe00', b.toHex());
+assert.equal(a, b.and('\x0f\x0f\x0f\x0f\x0f\x0f', a));
+assert.equal('0e0e040e00', a.toHex());
+assert.throws(function() { b.xor(''); });
+assert.throws(function() { b.xor('a', new Buffer(4)); });
+assert.throws(function() { b.not([]); });
+assert.throws(function() { buffertools.xor(b, 42); });
+
+// cross-check the kernels and the operand repetition byte by byte
+for (var i = 0; i < 200; i++) {
+	var n = 1 + (Math.random() * 1100 | 0), m = 1 + (Math.random() * [4, 40, 300][i % 3] | 0);
+	a = new Buffer(n), b = new Buffer(m), c = new Buffer(n);
+	for (var k = 0; k < n; k++) a[k] = Math.random() * 256 | 0;
+	for (var k = 0; k < m; k++) b[k] = Math.random() * 256 | 0;
+	buffertools.xor(a, b, c);
+	for (var k = 0; k < n; k++) assert.equal(a[k] ^ b[k % m], c[k]);
+	buffertools.or(a, b, c);
+	for (var k = 0; k < n; k++) assert.equal(a[k] | b[k % m], c[k]);
+	// the operand is a part of the buffer that is being changed
+	a.copy(c);
+	c.and(c.slice(n >> 1, (n >> 1) + m));
+	var d = a.slice(n >> 1, (n >> 1) + m);
+	for (var k = 0; k < n; k++) assert.equal(a[k] & d[k % d.length], c[k]);
+}
+
+// a target that overlaps the buffer at another offset, in both directions
+for (var shift = -40; shift <= 40; shift += 1) {
+	a = new Buffer(300);
+	for (var k = 0; k < a.length; k++) a[k] = Math.random() * 256 | 0;
+	var src = a.slice(100, 250), copy = new Buffer(src);
+	buffertools.xor(src, new Buffer([0xff, 0x0f]), a.slice(100 + shift, 250 + shift));
+	for (var k = 0; k < copy.length; k++) {
+		assert.equal(copy[k] ^ [0xff, 0x0f][k % 2], a[100 + shift + k]);
+	}
+}
+
 assert.equal('', new Buffer('').reverse());
 assert.equal('For great justice.', new Buffer('.ecitsuj taerg roF').reverse());
 
+// reverse and swap around the block sizes of the kernels
+for (var i = 0; i < 200; i++) {
+	var n = i < 100 ? i : Math.random() * 1000 | 0, s = [];
+	b = new Buffer(n);
+	for (var k = 0; k < n; k++) s.push(b[k] = Math.random() * 256 | 0);
+	assert.deepEqual(s.slice().reverse(), Array.prototype.slice.call(b.reverse()));
+	[2, 4, 8].forEach(function(width) {
+		b = new Buffer(s.slice(0, n - n % width));
+		assert.equal(b, buffertools['swap' + width * 8](b));
+		for (var k = 0; k < b.length; k++) {
+			assert.equal(s[k - k % width + width - 1 - k % width], b[k]);
+		}
+	});
+}
+
+b = new Buffer([1, 2, 3, 4, 5, 6, 7, 8]);
+assert.equal('0201040306050807', b.swap16().toHex());
+assert.equal('0304010207080506', b.swap32().toHex());
+assert.equal('0605080702010403', b.swap64().toHex());
+assert.throws(function() { new Buffer(3).swap16(); });
+assert.throws(function() { new Buffer(6).swap32(); });
+assert.throws(function() { new Buffer(12).swap64(); });
+
 // bug fix, see http://github.com/bnoordhuis/node-buffertools/issues#issue/5
 var endOfHeader = new Buffer('\r\n\r\n');
 assert.equal(0, endOfHeader.indexOf(endOfHeader));
@@ -129,8 +391,682 @@ assert.equal('Hello, world!', stream.getBuffer().toString());
 // closed stream should throw
 assert.throws(function() { stream.write('ZIG!'); });
 
+// writes that span chunks, string encodings and getBuffer() between writes
+stream = new WritableBufferStream();
+assert.equal(0, stream.getBuffer().length);
+var expected = [];
+for (var i = 0; i < 2000; i++) {
+	b = new Buffer(i % 97);
+	b.fill(i & 255);
+	stream.write(b);
+	expected.push(b.toString('hex'));
+	b.fill(0);  // the stream should have made a copy
+	stream.write('\u00e9' + i, i & 1 ? 'utf8' : 'binary');
+	expected.push(new Buffer('\u00e9' + i, i & 1 ? 'utf8' : 'binary').toString('hex'));
+	stream.write('2a', 'hex');
+	expected.push('2a');
+	if (i % 500 == 0) {
+		assert.equal(expected.join(''), stream.getBuffer().toString('hex'));
+	}
+}
+stream.write(new Buffer(100000));
+expected.push(new Buffer(100000).fill(0).toString('hex'));
+stream.end('');
+assert.equal(expected.join(''), stream.getBuffer().toString('hex'));
+assert.equal(stream.getBuffer(), stream.getBuffer());
+
+// hashing a stream doesn't join the chunks
+stream = new WritableBufferStream();
+for (var i = 0; i < 5000; i++) stream.write('chunk' + i);
+var crc = stream.crc32c(), hash = stream.hash64();
+assert.ok(stream.chunks.length > 1);
+assert.equal(stream.getBuffer().crc32c(), crc);
+assert.equal(stream.getBuffer().hash64().toString('hex'), hash.toString('hex'));
+assert.equal(crc, new WritableBufferStream().crc32c(crc));
+
 // GH-10 indexOf sometimes incorrectly returns -1
 for (var i = 0; i < 100; i++) {
 	var buffer = new Buffer('9A8B3F4491734D18DEFC6D2FA96A2D3BC1020EECB811F037F977D039B4713B1984FBAB40FCB4D4833D4A31C538B76EB50F40FA672866D8F50D0A1063666721B8D8322EDEEC74B62E5F5B959393CD3FCE831CC3D1FA69D79C758853AFA3DC54D411043263596BAD1C9652970B80869DD411E82301DF93D47DCD32421A950EF3E555152E051C6943CC3CA71ED0461B37EC97C5A00EBACADAA55B9A7835F148DEF8906914617C6BD3A38E08C14735FC2EFE075CC61DFE5F2F9686AB0D0A3926604E320160FDC1A4488A323CB4308CDCA4FD9701D87CE689AF999C5C409854B268D00B063A89C2EEF6673C80A4F4D8D0A00163082EDD20A2F1861512F6FE9BB479A22A3D4ACDD2AA848254BA74613190957C7FCD106BF7441946D0E1A562DA68BC37752B1551B8855C8DA08DFE588902D44B2CAB163F3D7D7706B9CC78900D0AFD5DAE5492535A17DB17E24389F3BAA6F5A95B9F6FE955193D40932B5988BC53E49CAC81955A28B81F7B36A1EDA3B4063CBC187B0488FCD51FAE71E4FBAEE56059D847591B960921247A6B7C5C2A7A757EC62A2A2A2A2A2A2A25552591C03EF48994BD9F594A5E14672F55359EF1B38BF2976D1216C86A59847A6B7C4A5C585A0D0A2A6D9C8F8B9E999C2A836F786D577A79816F7C577A797D7E576B506B57A05B5B8C4A8D99989E8B8D9E644A6B9D9D8F9C9E4A504A6B968B93984A93984A988FA19D919C999F9A4A8B969E588C93988B9C938F9D588D8B9C9E9999989D58909C8F988D92588E0D0A3D79656E642073697A653D373035393620706172743D31207063726333323D33616230646235300D0A2E0D0A').fromHex();
 	assert.equal(551, buffer.indexOf('=yend'));
 }
+
+// compiled patterns
+var pattern = buffertools.compilePattern('--');
+b = new Buffer('a--b--c----d');
+assert.equal(1,  pattern.indexOf(b));
+assert.equal(4,  pattern.indexOf(b, 2));
+assert.equal(8,  pattern.indexOf(b, -4));
+assert.equal(-1, pattern.indexOf(b, 11));
+assert.equal(9,  pattern.lastIndexOf(b));
+assert.equal(4,  pattern.lastIndexOf(b, 8));
+assert.equal(1,  pattern.lastIndexOf(b, -7));
+assert.equal(-1, pattern.lastIndexOf(b, 2));
+assert.equal(4,  pattern.count(b));
+assert.equal(2,  pattern.count(b, 5));
+assert.equal(0,  pattern.count(new Buffer('abc')));
+assert.equal(-1, buffertools.compilePattern('').indexOf(b));
+assert.equal(0,  buffertools.compilePattern('').count(b));
+assert.equal(2,  new Buffer('\r\n').compilePattern().indexOf(new Buffer('ab\r\n')));
+assert.throws(function() { buffertools.compilePattern(42); });
+assert.throws(function() { pattern.indexOf('a--b'); });
+
+// cross-check the reverse search against String#lastIndexOf
+for (var i = 0; i < 200; i++) {
+	var s = '', t = '';
+	for (var k = 0, n = 1 + i % 40; k < n; k++) s += 'ab'.charAt(Math.random() * 2 | 0);
+	for (var k = 0, n = 1 + i % 4; k < n; k++) t += 'ab'.charAt(Math.random() * 2 | 0);
+	pattern = buffertools.compilePattern(t);
+	assert.equal(s.indexOf(t), pattern.indexOf(new Buffer(s)));
+	assert.equal(s.lastIndexOf(t), pattern.lastIndexOf(new Buffer(s)));
+}
+
+// exercise every search strategy: single byte, short needle and Boyer-Moore
+for (var i = 0; i < 300; i++) {
+	var s = '', t;
+	for (var k = 0, n = 64 + i; k < n; k++) s += 'abc'.charAt(Math.random() * 3 | 0);
+	var m = [1, 2, 7, 16, 32, 33, 48][i % 7];
+	t = i & 8 ? s.substr(Math.random() * (s.length - m) | 0, m) : s.substr(0, m - 1) + 'd';
+	assert.equal(s.indexOf(t), new Buffer(s).indexOf(t));
+	assert.equal(s.indexOf(t, 17), new Buffer(s).indexOf(t, 17));
+	assert.equal(s.lastIndexOf(t), new Buffer(s).lastIndexOf(t));
+	assert.equal(s.lastIndexOf(t), buffertools.compilePattern(t).lastIndexOf(new Buffer(s)));
+}
+
+// multi-pattern matching
+var matcher = buffertools.createMatcher(['he', 'she', new Buffer('hers'), 'his', '']);
+var matches = new Int32Array(16);
+assert.equal(4, matcher.match(new Buffer('ushers his'), matches));
+assert.deepEqual([1, 1, 2, 0, 2, 2, 7, 3], Array.prototype.slice.call(matches, 0, 8));
+assert.equal(1, matcher.match(new Buffer('ushers his'), matches, 4));
+assert.deepEqual([7, 3], Array.prototype.slice.call(matches, 0, 2));
+assert.equal(0, matcher.match(new Buffer('xyz'), matches));
+// too small an output array still returns the total number of matches
+matches = new Int32Array(2);
+assert.equal(4, matcher.match(new Buffer('ushers his'), matches));
+assert.deepEqual([1, 1], Array.prototype.slice.call(matches));
+assert.equal(2, buffertools.createMatcher(['a', 'a']).match(new Buffer('a'), matches));
+assert.throws(function() { buffertools.createMatcher('abc'); });
+assert.throws(function() { buffertools.createMatcher(['abc', 42]); });
+assert.equal(undefined, Buffer.prototype.createMatcher);  // not a buffer method
+assert.throws(function() { matcher.match(new Buffer('abc'), []); });
+
+// checksums and hashes, known values
+assert.equal(0, new Buffer('').crc32c());
+assert.equal(0xe3069283, new Buffer('123456789').crc32c());
+assert.equal(0xe3069283, buffertools.crc32c(new Buffer('6789'), buffertools.crc32c(new Buffer('12345'))));
+assert.equal('ef46db3751d8e999', new Buffer('').hash64().toString('hex'));
+assert.equal('44bc2cf5ad770999', buffertools.hash64(new Buffer('abc')).toString('hex'));
+assert.equal('13c1d910702770e6', new Buffer('abc').hash64(42).toString('hex'));
+assert.equal('0b242d361fda71bc', buffertools.createHash64()
+	.update('The quick brown ')
+	.update(new Buffer('fox jumps over the lazy dog'))
+	.digest().toString('hex'));
+
+// incremental hashing in uneven pieces gives the same result
+for (var i = 0; i < 50; i++) {
+	var n = Math.random() * 300 | 0, a = new Buffer(n), hash = buffertools.createHash64(i), crc = 0;
+	for (var k = 0; k < n; k++) a[k] = Math.random() * 256 | 0;
+	for (var k = 0; k < n; k += m) {
+		var m = 1 + (Math.random() * 40 | 0);
+		hash.update(a.slice(k, k + m));
+		crc = a.slice(k, k + m).crc32c(crc);
+	}
+	assert.equal(a.hash64(i).toString('hex'), hash.digest().toString('hex'));
+	assert.equal(a.crc32c(), crc);
+}
+assert.throws(function() { buffertools.createHash64().update(42); }, TypeError);
+assert.equal(undefined, Buffer.prototype.createHash64);
+
+// batch actions, arrays and packed buffers
+var keys = ['abc', 'abd', 'ab', '', 'xabcx'].map(function(s) { return new Buffer(s); });
+var packed = buffertools.concat.apply(buffertools, keys);
+var offsets = new Uint32Array([0, 3, 6, 8, 8, 13]);
+[[keys], [packed, offsets]].forEach(function(items) {
+	function call(name) {
+		return buffertools[name].apply(buffertools, items.concat(Array.prototype.slice.call(arguments, 1)));
+	}
+	var r = call('compareMany', 'abc');
+	assert.ok(r instanceof Int32Array);
+	assert.deepEqual([0, 1, -1, -1, 1], Array.prototype.map.call(r, Math.sign));
+	r = call('equalsMany', new Buffer('abd'));
+	assert.ok(r instanceof Uint8Array);
+	assert.deepEqual([0, 1, 0, 0, 0], Array.prototype.slice.call(r));
+	assert.deepEqual([1, 1, 1, -1, 2], Array.prototype.slice.call(call('indexOfMany', 'b')));
+	assert.deepEqual([-1, -1, -1, -1, 2], Array.prototype.slice.call(call('indexOfMany', 'b', 2)));
+	assert.deepEqual([0, -1, -1, -1, 1], Array.prototype.slice.call(call('indexOfMany', 'abc')));
+	assert.deepEqual(['616263', '616264', '6162', '', '7861626378'], call('toHexMany'));
+});
+assert.equal(0, buffertools.compareMany([], 'a').length);
+assert.equal(0, buffertools.equalsMany(new Buffer(0), new Uint32Array(0), 'a').length);
+assert.throws(function() { buffertools.compareMany(42, 'a'); }, TypeError);
+assert.throws(function() { buffertools.equalsMany(['a'], 'a'); }, TypeError);
+assert.throws(function() { buffertools.indexOfMany(keys, 42); }, TypeError);
+assert.throws(function() { buffertools.toHexMany(packed, new Uint32Array([0, 14])); }, RangeError);
+assert.throws(function() { buffertools.toHexMany(packed, new Uint32Array([3, 0])); }, RangeError);
+
+// packed fixed-width keys, cross-checked against Array#sort
+[[1, 1000, 3], [4, 5000, 256], [20, 3000, 2], [40, 2000, 256]].forEach(function(t) {
+	var width = t[0], n = t[1], keys = new Buffer(width * n);
+	for (var i = 0; i < keys.length; i++) {
+		// long common prefixes take the introsort path
+		keys[i] = i % width < 18 && width > 18 ? 1 : Math.random() * t[2] | 0;
+	}
+	var expected = [];
+	for (var i = 0; i < n; i++) expected.push(keys.slice(i * width, (i + 1) * width).toString('hex'));
+	expected.sort();
+	assert.ok(keys === keys.sortFixed(width));
+	assert.equal(expected.join(''), keys.toString('hex'));
+
+	var key = new Buffer(expected[n >> 1], 'hex');
+	var first = expected.indexOf(expected[n >> 1]);
+	assert.equal(first, keys.lowerBound(width, key));
+	assert.equal(first, buffertools.binarySearchFixed(keys, width, key));
+	key.fill(0);
+	assert.equal(expected[0] === key.toString('hex') ? 0 : -1, keys.binarySearchFixed(width, key));
+	assert.equal(0, keys.lowerBound(width, key));
+	key.fill(0xff);
+	assert.equal(n, keys.lowerBound(width, key));
+});
+assert.equal(1, new Buffer('aacc').lowerBound(2, 'bb'));
+assert.equal(-1, new Buffer('aacc').binarySearchFixed(2, 'bb'));
+assert.equal(1, new Buffer('aacc').binarySearchFixed(2, 'cc'));
+assert.equal(0, new Buffer('').lowerBound(2, 'bb'));
+assert.equal('abcd', new Buffer('cdab').sortFixed(2).toString());
+assert.throws(function() { new Buffer('abc').sortFixed(2); }, RangeError);
+assert.throws(function() { new Buffer('abcd').sortFixed(0); }, RangeError);
+assert.throws(function() { new Buffer('abcd').lowerBound(2, 'abc'); }, RangeError);
+assert.throws(function() { new Buffer('abcd').lowerBound(2, 42); }, TypeError);
+
+// segmented buffers
+var list = buffertools.createBufferList();
+assert.equal(0, list.length);
+assert.equal(undefined, Buffer.prototype.createBufferList);
+assert.equal(-1, list.indexOf('a'));
+assert.equal(3, list.push(new Buffer('foo')));
+assert.equal(3, list.push(new Buffer(0)));
+assert.equal(6, list.push(new Buffer('bar')));
+assert.equal(9, list.push(new Buffer('baz')));
+assert.equal(9, list.length);
+assert.equal(2, list.indexOf('ob'));
+assert.equal(4, list.indexOf(new Buffer('arb')));
+assert.equal(-1, list.indexOf('arb', 5));
+assert.equal(7, list.indexOf('a', 5));
+assert.equal(-1, list.indexOf(''));
+assert.equal('obarb', list.slice(2, 7).toString());
+assert.equal('baz', list.slice(-3).toString());
+assert.ok(list.equals('barb', 3));
+assert.ok(!list.equals('barbazz', 3));
+assert.equal(0, list.compare('foobarbaz'));
+assert.ok(list.compare('fooc') < 0);
+assert.ok(list.compare('y', 8) > 0);
+assert.equal('fo', list.consume(2).toString());
+assert.equal(7, list.length);
+assert.equal(0, list.indexOf('oba'));
+b = new Buffer('bar');
+list = buffertools.createBufferList();
+list.push(b);
+assert.equal(b, list.consume(3));  // whole chunks are returned as-is
+assert.equal(0, list.length);
+assert.throws(function() { list.push('abc'); });
+assert.throws(function() { list.indexOf(42); });
+assert.throws(function() { list.equals(42); });
+
+// cross-check against a contiguous buffer
+for (var i = 0; i < 300; i++) {
+	var s = '', list = buffertools.createBufferList();
+	for (var k = 0, n = 1 + i % 30; k < n; k++) {
+		var chunk = '';
+		for (var j = 0, m = Math.random() * (i & 1 ? 4 : 40) | 0; j < m; j++) {
+			chunk += 'ab'.charAt(Math.random() * 2 | 0);
+		}
+		s += chunk;
+		list.push(new Buffer(chunk));
+	}
+	var t = '', start = Math.random() * 10 | 0;
+	for (var k = 0, n = 1 + i % 40; k < n; k++) t += 'ab'.charAt(Math.random() * 2 | 0);
+	if (i & 2) t = s.substr(s.length >> 1, 1 + i % 40);
+	assert.equal(s.length, list.length);
+	assert.equal(t.length ? s.indexOf(t) : -1, list.indexOf(t));
+	if (t.length && start <= s.length) assert.equal(s.indexOf(t, start), list.indexOf(t, start));
+	assert.equal(s.substr(3, 17), list.slice(3, 20).toString());
+	assert.ok(list.equals(s.substr(5, 9), 5));
+	assert.ok(!list.equals(s.substr(5, 9) + 'c', 5));
+	assert.equal(s.substr(0, 7), list.consume(7).toString());
+	assert.equal(s.substr(7), list.slice().toString());
+	var expected = t.length ? s.indexOf(t, 7) : -1;
+	assert.equal(expected < 0 ? -1 : expected - 7, list.indexOf(t));
+}
+
+// async variants, on the thread pool and below the threshold
+var pending = 0;
+process.on('exit', function() { assert.equal(0, pending); });
+
+[100, 3 * buffertools.asyncThreshold + 7].forEach(function(size) {
+	var a = new Buffer(size);
+	for (var i = 0; i < size; i++) a[i] = Math.random() * 256 | 0;
+	new Buffer('needle').copy(a, size - 50);
+	var hex = new Buffer(buffertools.toHex(a));
+
+	pending += 7;
+	a.toHexAsync(function(err, s) {
+		assert.equal(null, err);
+		assert.equal(a.toString('hex'), s);
+		pending--;
+	});
+	buffertools.fromHexAsync(hex, function(err, b) {
+		assert.equal(null, err);
+		assert.ok(buffertools.equals(a, b));
+		pending--;
+	});
+	buffertools.indexOfAsync(a, 'needle', function(err, offset) {
+		assert.equal(null, err);
+		assert.equal(buffertools.indexOf(a, 'needle'), offset);
+		pending--;
+	});
+	buffertools.indexOfAsync(a, new Buffer('needle'), size - 49, function(err, offset) {
+		assert.equal(null, err);
+		assert.equal(-1, offset);
+		pending--;
+	});
+	buffertools.fillAsync(new Buffer(size), 'abc', function(err, b) {
+		assert.equal(null, err);
+		assert.equal(size, b.length);
+		assert.equal('abcabca', b.slice(0, 7).toString());
+		assert.equal(new Buffer(size).fill('abc').toString(), b.toString());
+		pending--;
+	});
+	var bad = new Buffer(hex.length);
+	hex.copy(bad);
+	bad[size] = 0x7a;	// 'z'
+	buffertools.fromHexAsync(bad, function(err, b) {
+		assert.ok(err instanceof Error);
+		pending--;
+	});
+	buffertools.fromHexAsync(hex.slice(1)).then(null, function(err) {
+		assert.ok(/Odd string length/.test(err.message));
+		pending--;
+	});
+});
+
+pending++;
+buffertools.toHexAsync(42, function(err) {
+	assert.ok(err instanceof TypeError);
+	pending--;
+});
+
+// parallel mode, small ranges so that matches straddle range boundaries
+buffertools.setParallelism(4, 1000);
+[1, 3, 20, 1500].forEach(function(needleSize) {
+	var size = buffertools.asyncThreshold + 12345;
+	var a = new Buffer(size);
+	for (var i = 0; i < size; i++) a[i] = 97 + (Math.random() * 2 | 0);
+	var needle = new Buffer(needleSize);
+	needle.fill('z');
+	// the later match is found first by some worker, the earlier one wins
+	needle.copy(a, size - needleSize - 3);
+	needle.copy(a, 2999 - (needleSize >> 1));
+
+	pending += 3;
+	a.indexOfAsync(needle, function(err, offset, mode) {
+		assert.equal(null, err);
+		assert.equal('parallel', mode);
+		assert.equal(buffertools.indexOf(a, needle), offset);
+		pending--;
+	});
+	a.indexOfAsync(needle, 3000, function(err, offset) {
+		assert.equal(size - needleSize - 3, offset);
+		pending--;
+	});
+	var b = new Buffer(size);
+	buffertools.xorAsync(a, needle.slice(0, 7 + needleSize % 5), b, function(err, c, mode) {
+		assert.equal('parallel', mode);
+		assert.ok(b === c);
+		assert.ok(buffertools.equals(buffertools.xor(new Buffer(a), needle.slice(0, 7 + needleSize % 5)), b));
+		pending--;
+	});
+});
+
+pending += 3;
+var big = new Buffer(buffertools.asyncThreshold + 999);
+big.fill(7);
+big.toHexAsync(function(err, s, mode) {
+	assert.equal('parallel', mode);
+	assert.equal(big.toString('hex'), s);
+	pending--;
+});
+buffertools.fromHexAsync(new Buffer(big.toString('hex')), function(err, b, mode) {
+	assert.equal('parallel', mode);
+	assert.ok(buffertools.equals(big, b));
+	pending--;
+});
+new Buffer(buffertools.asyncThreshold + 1).fillAsync('abcdefg', function(err, b, mode) {
+	assert.equal('parallel', mode);
+	assert.equal(new Buffer(b.length).fill('abcdefg').toString(), b.toString());
+	pending--;
+});
+new Buffer(100).toHexAsync(function(err, s, mode) {
+	assert.equal('sync', mode);
+});
+buffertools.setParallelism(1);
+new Buffer(buffertools.asyncThreshold).toHexAsync(function(err, s, mode) {
+	assert.equal('thread', mode);
+});
+assert.throws(function() { buffertools.setParallelism(0); });
+assert.equal(undefined, Buffer.prototype.setParallelism);
+
+// hex streams, with chunks that split digit pairs and exceed a slab
+(function() {
+	var size = 300000, data = new Buffer(size);
+	for (var i = 0; i < size; i++) data[i] = Math.random() * 256 | 0;
+	var encoder = new buffertools.HexEncoder(), decoder = buffertools.HexDecoder();
+	var hex = [], out = [];
+	encoder.on('data', function(chunk) { hex.push(chunk); });
+	encoder.pipe(decoder).on('data', function(chunk) {
+		assert.ok(chunk.length <= 64 * 1024);
+		out.push(chunk);
+	});
+	pending++;
+	decoder.on('end', function() {
+		assert.equal(data.toString('hex'), Buffer.concat(hex).toString());
+		assert.ok(buffertools.equals(data, Buffer.concat(out)));
+		pending--;
+	});
+	for (var i = 0; i < size; i += n) {
+		var n = [1, 3, 7, 150000][Math.random() * 4 | 0];
+		encoder.write(data.slice(i, i + n));
+	}
+	encoder.end();
+})();
+
+['abc', 'ab\ncd', 'ax'].forEach(function(input) {
+	var decoder = new buffertools.HexDecoder();
+	pending++;
+	decoder.on('error', function(err) {
+		assert.ok(/hexadecimal/.test(err.message));
+		pending--;
+	});
+	decoder.resume();
+	decoder.write(input.slice(0, 1));
+	decoder.end(input.slice(1));
+});
+
+var decoder = buffertools.createHexDecoder(), b = new Buffer(4);
+assert.equal(0, decoder.decode(new Buffer('6'), b));
+assert.equal(2, decoder.decode(new Buffer('162'), b, 1));
+assert.equal('ab', b.slice(1, 3).toString());
+assert.throws(function() { decoder.decode(new Buffer('636465666768'), b); }, RangeError);
+assert.equal(undefined, Buffer.prototype.createHexDecoder);
+
+// split
+b = new Buffer('GET / HTTP/1.1\r\nHost: x\r\n\r\n');
+assert.deepEqual(['GET / HTTP/1.1', 'Host: x', '', ''],
+                 b.split('\r\n').map(String));
+assert.deepEqual(['GET / HTTP/1.1', 'Host: x'],
+                 buffertools.split(b, new Buffer('\r\n'), 2).map(String));
+assert.deepEqual([], b.split('\r\n', 0));
+assert.deepEqual(['abc'], new Buffer('abc').split(',').map(String));
+assert.deepEqual(['', ''], new Buffer(',').split(',').map(String));
+assert.deepEqual(['a', 'bé'], new Buffer('aÿbé', 'latin1')
+                 .split('ÿ', undefined, 'latin1').map(function(s) {
+	return s.toString('latin1');
+}));
+assert.throws(function() { b.split(''); });
+// fields are slices, not copies
+b.split('\r\n')[1][0] = 0x68;
+assert.equal('host: x', b.split('\r\n')[1].toString());
+// more fields than fit in the scratch array
+a = new Array(1001).join('x,');
+assert.deepEqual(a.split(','), new Buffer(a).split(',').map(String));
+var offsets = new Int32Array(4);
+assert.equal(4, buffertools.splitOffsets(new Buffer('a,bc,,d'), ',', offsets));
+assert.deepEqual([0, 1, 2, 2], Array.prototype.slice.call(offsets));
+assert.throws(function() { buffertools.splitOffsets(b, ',', []); }, TypeError);
+
+// Splitter, with delimiters and records that straddle chunks
+(function() {
+	var lines = [];
+	for (var i = 0; i < 2000; i++) {
+		lines.push(new Array((Math.random() * 50 | 0) + 2).join(String.fromCharCode(97 + i % 26)));
+	}
+	var data = new Buffer(lines.join('\r\n'));
+	var splitter = buffertools.Splitter('\r\n'), records = [];
+	splitter.on('data', function(record) { records.push(record.toString()); });
+	pending++;
+	splitter.on('end', function() {
+		assert.deepEqual(lines, records);
+		pending--;
+	});
+	for (var i = 0; i < data.length; i += n) {
+		var n = [1, 2, 5, 1000][Math.random() * 4 | 0];
+		splitter.write(data.slice(i, i + n));
+	}
+	splitter.end();
+})();
+
+// async fill of a range, split over the pool threads
+(function() {
+	var b = new Buffer(1 << 20);
+	b.fill(0);
+	pending++;
+	b.fillAsync('abc', 1, b.length - 1, function(err, result) {
+		assert.ifError(err);
+		assert.equal(0, b[0]);
+		assert.equal(0, b[b.length - 1]);
+		assert.equal('abcabc', b.slice(1, 7).toString());
+		assert.equal('abc'[(b.length - 3) % 3], String.fromCharCode(b[b.length - 2]));
+		pending--;
+	});
+})();
+
+// memory mapped files
+(function() {
+	var file = path.join(os.tmpdir(), 'buffertools-test-' + process.pid);
+	var data = new Buffer(3 * 4096 + 100);
+	for (var i = 0; i < data.length; i++) data[i] = i * 7 % 251;
+	fs.writeFileSync(file, data);
+
+	try {
+		var mapped = buffertools.mmap(file, { advice: 'sequential', willNeed: true });
+		assert.ok(Buffer.isBuffer(mapped));
+		assert.ok(mapped.equals(data));
+		assert.equal(data.crc32c(), mapped.crc32c());
+		assert.equal(data.length - 100, mapped.lastIndexOf(data.slice(-100)));
+		assert.equal(0, mapped.indexOf(data.slice(0, 100)));
+
+		// Offsets that aren't page aligned and ranges past the end.
+		assert.ok(buffertools.mmap(file, 4097, 10).equals(data.slice(4097, 4107)));
+		assert.ok(buffertools.mmap(file, 5000).equals(data.slice(5000)));
+		assert.ok(buffertools.mmap(file, undefined, 10).equals(data.slice(0, 10)));
+		assert.equal(0, buffertools.mmap(file, data.length + 1).length);
+
+		// The mapping is read-only, so are slices of it.
+		var head = mapped.slice(0, 10);
+		assert.throws(function() { mapped.fill(0, 0, 10); }, TypeError);
+		assert.throws(function() { head.clear(); }, TypeError);
+		assert.throws(function() { head.xor('x'); }, TypeError);
+		assert.throws(function() { data.xor('x', mapped); }, TypeError);
+		assert.throws(function() { data.slice(0, 5).toHexInto(head); }, TypeError);
+		assert.throws(function() { head.reverse(); }, TypeError);
+		assert.ok(fs.readFileSync(file).equals(data));
+
+		var slice = mapped.slice(8192);
+		assert.equal(true, buffertools.munmap(slice));
+		assert.equal(false, mapped.munmap());
+		assert.equal(false, buffertools.munmap(data));
+		if (mapped instanceof Uint8Array) {
+			assert.equal(0, mapped.length);
+			assert.equal(0, slice.length);
+			assert.equal(0, head.length);
+		}
+
+		assert.throws(function() { buffertools.mmap(file, -1); }, RangeError);
+		assert.throws(function() { buffertools.mmap(file, { advice: 'often' }); }, TypeError);
+		assert.throws(function() { buffertools.mmap(42); }, TypeError);
+		assert.equal(undefined, Buffer.prototype.mmap);
+		assert.equal('function', typeof Buffer.prototype.munmap);
+		assert.throws(function() { buffertools.munmap('abc'); }, TypeError);
+		assert.throws(function() {
+			buffertools.mmap(file + '.missing');
+		}, function(err) {
+			return err.code === 'ENOENT' && err.syscall === 'open';
+		});
+	} finally {
+		fs.unlinkSync(file);
+	}
+})();
+
+// count, histogram, validation and byte sets
+(function() {
+	var b = new Buffer('abracadabra');
+	assert.equal(5, b.count('a'));
+	assert.equal(5, b.count(97));
+	assert.equal(4, b.count('a', 1));
+	assert.equal(2, b.count('abra'));
+	assert.equal(2, b.count(new Buffer('bra')));
+	assert.equal(1, new Buffer('aaaa').count('aaa'));
+	assert.equal(2, new Buffer('aaaa').count('aa'));
+	assert.equal(0, b.count('z'));
+	assert.equal(1, new Buffer('été').count('t', 0, 'binary'));
+	assert.throws(function() { b.count(''); }, Error);
+	assert.throws(function() { b.count({}); }, TypeError);
+
+	var counts = b.histogram();
+	assert.ok(counts instanceof Uint32Array);
+	assert.equal(256, counts.length);
+	assert.equal(5, counts[97]);
+	assert.equal(2, counts[114]);
+	assert.equal(0, counts[122]);
+	assert.strictEqual(counts, buffertools.histogram(new Buffer('zz'), counts));
+	assert.equal(2, counts[122]);
+	assert.equal(5, counts[97]);
+	assert.throws(function() { b.histogram(new Uint32Array(16)); }, TypeError);
+
+	assert.equal(true, new Buffer(0).isAscii());
+	assert.equal(true, b.isAscii());
+	assert.equal(false, new Buffer('héllo').isAscii());
+	assert.equal(true, new Buffer('héllo € 😀').isUtf8());
+	[
+		[0xc0, 0x80],              // overlong
+		[0xe0, 0x80, 0x80],        // overlong
+		[0xf0, 0x80, 0x80, 0x80],  // overlong
+		[0xed, 0xa0, 0x80],        // surrogate
+		[0xf4, 0x90, 0x80, 0x80],  // past U+10FFFF
+		[0xf5, 0x80, 0x80, 0x80],
+		[0x80],
+		[0xe2, 0x82],              // truncated
+		[0xff]
+	].forEach(function(bytes) {
+		var bad = new Buffer(bytes);
+		assert.equal(false, bad.isUtf8(), bad.toString('hex'));
+		// Across a block boundary and in the middle of ASCII.
+		for (var at = 28; at < 36; at++) {
+			var padded = new Buffer(at + bytes.length + 40);
+			padded.fill('x');
+			bad.copy(padded, at);
+			assert.equal(false, padded.isUtf8(), at + ' ' + bad.toString('hex'));
+		}
+	});
+
+	// Random sequences of valid and invalid characters against node's decoder.
+	var pieces = ['a', 'abcdefghijklmnopqrstuvwxyz0123456789', 'é', '€', '😀'];
+	for (var n = 0; n < 500; n++) {
+		var parts = [];
+		while (Math.random() < 0.97) {
+			parts.push(new Buffer(pieces[Math.random() * pieces.length | 0]));
+		}
+		var s = Buffer.concat(parts);
+		if (s.length > 0 && Math.random() < 0.5) {
+			s[Math.random() * s.length | 0] = Math.random() * 256 | 0;
+		}
+		var valid = new Buffer(s.toString()).equals(s);
+		assert.equal(valid, s.isUtf8(), s.toString('hex'));
+		assert.equal(s.every ? s.every(function(c) { return c < 128; }) : s.isAscii(), s.isAscii());
+	}
+
+	var text = new Buffer('key = value; other=thing');
+	assert.equal(3, text.findFirstOf(' =;'));
+	assert.equal(3, text.findFirstOf(' '));
+	assert.equal(11, text.findFirstOf(';', 4));
+	assert.equal(-1, text.findFirstOf('#'));
+	assert.equal(-1, text.findFirstOf(''));
+	assert.equal(0, text.findFirstNotOf(' '));
+	assert.equal(6, text.findFirstNotOf(' =', 3));
+	assert.equal(-1, new Buffer('   ').findFirstNotOf(' '));
+	assert.equal(0, text.findFirstNotOf(''));
+
+	// Every position and every high/low nibble against a simple loop.
+	for (var n = 0; n < 200; n++) {
+		var hay = new Buffer(1 + (Math.random() * 100 | 0));
+		for (var i = 0; i < hay.length; i++) hay[i] = Math.random() * 256 | 0;
+		var set = new Buffer(Math.random() * 8 | 0);
+		for (var i = 0; i < set.length; i++) set[i] = Math.random() * 256 | 0;
+		var start = Math.random() * hay.length | 0;
+		var first = -1, firstNot = -1;
+		for (var i = start; i < hay.length; i++) {
+			var inSet = Array.prototype.indexOf.call(set, hay[i]) !== -1;
+			if (inSet && first === -1) first = i;
+			if (!inSet && firstNot === -1) firstNot = i;
+		}
+		assert.equal(first, hay.findFirstOf(set, start));
+		assert.equal(firstNot, hay.findFirstNotOf(set, start));
+	}
+})();
+
+// stats
+(function() {
+	buffertools.resetStats();
+	assert.deepEqual({}, buffertools.stats());
+	new Buffer('abc').indexOf('b');
+	assert.deepEqual({}, buffertools.stats());
+
+	assert.equal(false, buffertools.enableStats());
+	try {
+		var b = new Buffer(1000);
+		b.fill('x');
+		b.indexOf('y');
+		buffertools.indexOf(b, 'x');
+		b.toHex();
+		b.indexOf(new Buffer(100).fill('y'));
+
+		var stats = buffertools.stats();
+		assert.equal(3, stats.indexOf.calls);
+		assert.equal(3000, stats.indexOf.bytes);
+		assert.ok(stats.indexOf.allocations >= 1);  // the Boyer-Moore tables
+		assert.equal(32, stats.indexOf.latency.length);
+		assert.equal(3, stats.indexOf.latency.reduce(function(a, b) { return a + b; }));
+		assert.ok(stats.indexOf.time > 0);
+		assert.equal(1, stats.toHex.calls);
+		assert.equal(1, stats.toHex.allocations);
+		assert.equal(2000, stats.toHex.allocatedBytes);
+		assert.equal(2, stats.fill.calls);
+
+		new Buffer(1000).fill('a').fromHex();
+		assert.equal(1, buffertools.stats().fromHex.allocations);
+		assert.equal(500, buffertools.stats().fromHex.allocatedBytes);
+
+		// functions that don't take a buffer, and the object methods
+		buffertools.concat(b, 'abc');
+		assert.equal(1003, buffertools.stats().concat.bytes);
+		buffertools.equalsMany([b, b.slice(10)], 'x');
+		assert.equal(1990, buffertools.stats().equalsMany.bytes);
+		buffertools.compilePattern('yy').indexOf(b);
+		assert.equal(1000, buffertools.stats()['pattern.indexOf'].bytes);
+		assert.equal(1, buffertools.stats().compilePattern.calls);
+		var list = buffertools.createBufferList();
+		list.push(b);
+		list.consume(10);
+		assert.equal(10, buffertools.stats()['bufferList.consume'].bytes);
+		buffertools.createHash64().update(b).digest();
+		assert.equal(1, buffertools.stats()['hash64.digest'].calls);
+
+		buffertools.resetStats();
+		assert.deepEqual({}, buffertools.stats());
+	} finally {
+		assert.equal(true, buffertools.enableStats(false));
+	}
+	b.indexOf('y');
+	assert.deepEqual({}, buffertools.stats());
+	assert.equal(undefined, Buffer.prototype.enableStats);
+	assert.equal(undefined, Buffer.prototype.resetStats);
+	assert.equal(undefined, Buffer.prototype.stats);
+})();